@@ -0,0 +1,329 @@
+#include "gitletobj.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+namespace fs = std::filesystem;
+namespace utils = gitlet::utils;
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::runtime_error;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::vector;
+using namespace gitlet::gitlet_obj;
+
+// shape of the synthetic repository and of the runs, set from the command
+// line as "--<name> <value>"
+struct Options {
+    size_t files = 200;      // working files
+    size_t commits = 100;    // commits besides the initial one
+    size_t branches = 4;     // branches the commits are spread over
+    size_t minSize = 256;    // smallest file in bytes
+    size_t maxSize = 65536;  // largest file in bytes
+    string sizes = "log";    // file size distribution: uniform or log
+    uint64_t seed = 1;       // seed of the generator
+    size_t iterations = 50;  // timed runs of each benchmark
+    fs::path dir = "/tmp/gitlet-bench";
+};
+
+// timings of one benchmark
+struct Result {
+    string name;
+    vector<double> seconds;  // of each operation
+    uint64_t bytes = 0;      // processed by all operations
+};
+
+static CommandExecutor ce;
+
+static Options parseArgs(int argc, char *argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; i += 2) {
+        string name = argv[i];
+        if (i + 1 == argc) {
+            throw runtime_error("missing value of " + name);
+        }
+        string value = argv[i + 1];
+        if (name == "--files") {
+            opts.files = std::stoul(value);
+        } else if (name == "--commits") {
+            opts.commits = std::stoul(value);
+        } else if (name == "--branches") {
+            opts.branches = std::stoul(value);
+        } else if (name == "--min-size") {
+            opts.minSize = std::stoul(value);
+        } else if (name == "--max-size") {
+            opts.maxSize = std::stoul(value);
+        } else if (name == "--sizes") {
+            opts.sizes = value;
+        } else if (name == "--seed") {
+            opts.seed = std::stoull(value);
+        } else if (name == "--iterations") {
+            opts.iterations = std::stoul(value);
+        } else if (name == "--dir") {
+            opts.dir = value;
+        } else {
+            throw runtime_error("unknown option " + name);
+        }
+    }
+    if (opts.files == 0 || opts.branches == 0 || opts.iterations == 0 ||
+        opts.minSize > opts.maxSize ||
+        (opts.sizes != "uniform" && opts.sizes != "log")) {
+        throw runtime_error("bad options");
+    }
+    return opts;
+}
+
+// Generates text files of random words, so they compress and delta like
+// real sources, with sizes drawn from the configured distribution.
+class Generator {
+  public:
+    explicit Generator(const Options &opts) : opts(opts), rng(opts.seed) {}
+
+    size_t size() {
+        if (opts.sizes == "uniform") {
+            return std::uniform_int_distribution<size_t>(opts.minSize,
+                                                         opts.maxSize)(rng);
+        }
+        std::uniform_real_distribution<double> exp(
+            std::log(double(opts.minSize) + 1), std::log(opts.maxSize + 1.0));
+        return size_t(std::exp(exp(rng))) - 1;
+    }
+
+    string text(size_t size) {
+        static const char *words[] = {
+            "commit", "branch", "merge", "blob",   "tree",   "index",
+            "stage",  "head",   "log",   "status", "object", "hash",
+            "pack",   "delta",  "graph", "parent", "file",   "remote"};
+        const size_t n = sizeof(words) / sizeof(words[0]);
+        string s;
+        s.reserve(size + 16);
+        for (size_t count = 1; s.size() < size; ++count) {
+            s += words[rng() % n];
+            s += count % 10 == 0 ? '\n' : ' ';
+        }
+        s.resize(size);
+        return s;
+    }
+
+    // rewrite a random line range of a file and append a line
+    string edit(const string &content) {
+        string s = content;
+        if (!s.empty()) {
+            size_t from = rng() % s.size();
+            size_t length = std::min<size_t>(s.size() - from, 64);
+            s.replace(from, length, text(length));
+        }
+        return s + text(40) + "\n";
+    }
+
+    size_t pick(size_t n) { return rng() % n; }
+
+  private:
+    const Options &opts;
+    std::mt19937_64 rng;
+};
+
+static string fileName(size_t i) {
+    string n = std::to_string(i);
+    return "file-" + string(n.size() < 5 ? 5 - n.size() : 0, '0') + n + ".txt";
+}
+
+static string branchName(size_t i) {
+    return i == 0 ? "master" : "branch-" + std::to_string(i);
+}
+
+static void run(Gitlet &git, const vector<string> &args) {
+    vector<string> argv = {"./bench"};
+    argv.insert(argv.end(), args.begin(), args.end());
+    ce.execCommand(git, argv);
+}
+
+// create the repository in the current directory, return total bytes of
+// the working files
+static uint64_t generate(Gitlet &git, const Options &opts, Generator &gen) {
+    run(git, {"init"});
+    vector<string> contents(opts.files);
+    vector<string> add = {"add"};
+    uint64_t bytes = 0;
+    for (size_t i = 0; i != opts.files; ++i) {
+        contents[i] = gen.text(gen.size());
+        utils::writeFile(fileName(i), contents[i]);
+        add.push_back(fileName(i));
+        bytes += contents[i].size();
+    }
+    run(git, add);
+    run(git, {"commit", "generate files"});
+    for (size_t b = 1; b < opts.branches; ++b) {
+        run(git, {"branch", branchName(b)});
+    }
+    // each commit edits a few files on the next branch
+    size_t edits = std::max<size_t>(1, opts.files / 20);
+    for (size_t c = 1; c < opts.commits; ++c) {
+        string branch = branchName(c % opts.branches);
+        if (branch != git.getCurBranch()) {
+            run(git, {"checkout", branch});
+        }
+        add = {"add"};
+        for (size_t e = 0; e != edits; ++e) {
+            string file = fileName(gen.pick(opts.files));
+            utils::writeFile(file, gen.edit(utils::readFile(file)));
+            add.push_back(file);
+        }
+        run(git, add);
+        run(git, {"commit", "commit " + std::to_string(c) + " on " + branch});
+    }
+    return bytes;
+}
+
+template <typename F>
+static Result timed(const string &name, size_t iterations, F f) {
+    Result r;
+    r.name = name;
+    for (size_t i = 0; i != iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        r.bytes += f(i);
+        std::chrono::duration<double> d =
+            std::chrono::steady_clock::now() - start;
+        r.seconds.push_back(d.count());
+    }
+    return r;
+}
+
+// a command with its output thrown away
+template <typename F>
+static Result timedCommand(const string &name, size_t iterations, F f) {
+    std::ostringstream sink;
+    auto *old = cout.rdbuf(sink.rdbuf());
+    Result r;
+    try {
+        r = timed(name, iterations, [&](size_t i) {
+            sink.str("");
+            return f(i);
+        });
+    } catch (...) {
+        cout.rdbuf(old);
+        throw;
+    }
+    cout.rdbuf(old);
+    return r;
+}
+
+static double percentile(const vector<double> &sorted, double p) {
+    size_t i = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+    return sorted[i] * 1e6;
+}
+
+static void report(const Options &opts, uint64_t repoBytes,
+                   const vector<Result> &results) {
+    cout << "{\n  \"options\": {\"files\": " << opts.files
+         << ", \"commits\": " << opts.commits
+         << ", \"branches\": " << opts.branches
+         << ", \"min_size\": " << opts.minSize
+         << ", \"max_size\": " << opts.maxSize << ", \"sizes\": \""
+         << opts.sizes << "\", \"seed\": " << opts.seed
+         << ", \"iterations\": " << opts.iterations
+         << ", \"repo_bytes\": " << repoBytes << "},\n  \"benchmarks\": [";
+    for (size_t i = 0; i != results.size(); ++i) {
+        const Result &r = results[i];
+        vector<double> sorted = r.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0;
+        for (double s : sorted) {
+            total += s;
+        }
+        cout << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << r.name
+             << "\", \"ops\": " << sorted.size()
+             << ", \"seconds\": " << total
+             << ", \"ops_per_sec\": " << sorted.size() / total
+             << ", \"bytes_per_sec\": " << r.bytes / total
+             << ", \"p50_us\": " << percentile(sorted, 0.5)
+             << ", \"p90_us\": " << percentile(sorted, 0.9)
+             << ", \"p99_us\": " << percentile(sorted, 0.99)
+             << ", \"max_us\": " << sorted.back() * 1e6 << "}";
+    }
+    cout << "\n  ]\n}" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        Options opts = parseArgs(argc, argv);
+        fs::remove_all(opts.dir);
+        fs::create_directories(opts.dir);
+        fs::current_path(opts.dir);
+        Generator gen(opts);
+        Gitlet git;
+        cerr << "generating the repository in " << opts.dir << endl;
+        uint64_t repoBytes = generate(git, opts, gen);
+        size_t n = opts.iterations;
+        vector<Result> results;
+
+        cerr << "running the benchmarks" << endl;
+        string chunk = gen.text(utils::chunkSize);
+        results.push_back(timed("sha1", n, [&](size_t) {
+            utils::hash({chunk});
+            return chunk.size();
+        }));
+        utils::setHashAlgorithm(utils::HashAlgorithm::sha256);
+        results.push_back(timed("sha256", n, [&](size_t) {
+            utils::hash({chunk});
+            return chunk.size();
+        }));
+        utils::setHashAlgorithm(utils::HashAlgorithm::sha1);
+        results.push_back(timed("hash-file", n, [&](size_t i) {
+            string file = fileName(i % opts.files);
+            utils::hashFile(file);
+            return fs::file_size(file);
+        }));
+        fs::path objects = "objects";
+        fs::create_directory(objects);
+        vector<string> contents(n);
+        for (size_t i = 0; i != n; ++i) {
+            contents[i] = gen.text(gen.size());
+        }
+        results.push_back(timed("save", n, [&](size_t i) {
+            utils::save(Blob(contents[i]), objects / std::to_string(i));
+            return contents[i].size();
+        }));
+        results.push_back(timed("load", n, [&](size_t i) {
+            Blob blob;
+            utils::load(blob, objects / std::to_string(i));
+            return blob.getContent().size();
+        }));
+        fs::remove_all(objects);
+
+        for (string command : {"status", "log", "global-log"}) {
+            results.push_back(timedCommand(command, n, [&](size_t) {
+                run(git, {command});
+                return 0;
+            }));
+        }
+        if (opts.branches > 1) {
+            results.push_back(timedCommand("checkout", n, [&](size_t i) {
+                size_t b = (i + 1 + opts.commits) % opts.branches;
+                if (branchName(b) == git.getCurBranch()) {
+                    b = (b + 1) % opts.branches;
+                }
+                run(git, {"checkout", branchName(b)});
+                return 0;
+            }));
+        }
+        report(opts, repoBytes, results);
+    } catch (const std::exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,499 @@
+#include "bitmap.h"
+
+#include "commitgraph.h"
+#include "gitletobj.h"
+#include "journal.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+namespace bitmap = gitlet::bitmap;
+namespace utils = gitlet::utils;
+namespace trace = gitlet::trace;
+namespace fs = std::filesystem;
+using namespace gitlet::gitlet_obj;
+using bitmap::Bitmap;
+using bitmap::Bitmaps;
+using bitmap::Reachable;
+using std::runtime_error;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+using std::unordered_map;
+using std::vector;
+
+const fs::path Bitmaps::file = ".gitlet/bitmap";
+
+static const char magic[] = "GBMP";
+static const uint32_t version = 1;
+static const size_t headerSize = 16;
+static const size_t idSize = 20;
+static const size_t entrySize = idSize + 1;  // binary id, kind
+// generations between the commits with a bitmap, besides the tips
+static const uint32_t interval = 32;
+static const uint64_t maxRun = 0xffffffff;
+static const uint64_t maxLiterals = 0x7fffffff;
+static const uint64_t ones = ~uint64_t(0);
+
+void Bitmap::set(size_t pos) {
+    if (pos / 64 >= words.size()) {
+        words.resize(pos / 64 + 1);
+    }
+    words[pos / 64] |= uint64_t(1) << (pos % 64);
+}
+
+bool Bitmap::test(size_t pos) const {
+    return pos / 64 < words.size() && (words[pos / 64] >> (pos % 64) & 1);
+}
+
+size_t Bitmap::count() const {
+    size_t n = 0;
+    for (uint64_t w : words) {
+        n += __builtin_popcountll(w);
+    }
+    return n;
+}
+
+Bitmap &Bitmap::operator|=(const Bitmap &other) {
+    if (other.words.size() > words.size()) {
+        words.resize(other.words.size());
+    }
+    for (size_t i = 0; i != other.words.size(); ++i) {
+        words[i] |= other.words[i];
+    }
+    return *this;
+}
+
+void Bitmap::andNot(const Bitmap &other) {
+    size_t n = std::min(words.size(), other.words.size());
+    for (size_t i = 0; i != n; ++i) {
+        words[i] &= ~other.words[i];
+    }
+}
+
+void Bitmap::forEach(const std::function<void(size_t)> &f) const {
+    for (size_t i = 0; i != words.size(); ++i) {
+        for (uint64_t w = words[i]; w; w &= w - 1) {
+            f(i * 64 + __builtin_ctzll(w));
+        }
+    }
+}
+
+// the number of words, then a marker word and its literal words at a time
+void Bitmap::compress(string &out) const {
+    utils::putU32(out, words.size());
+    size_t n = words.size(), i = 0;
+    while (i != n) {
+        uint64_t bit = 0, run = 0;
+        if (words[i] == 0 || words[i] == ones) {
+            uint64_t clean = words[i];
+            bit = clean & 1;
+            for (; i != n && words[i] == clean && run != maxRun; ++i) {
+                ++run;
+            }
+        }
+        size_t begin = i;
+        while (i != n && words[i] != 0 && words[i] != ones &&
+               i - begin != maxLiterals) {
+            ++i;
+        }
+        utils::putU64(out, bit | run << 1 | uint64_t(i - begin) << 33);
+        for (size_t j = begin; j != i; ++j) {
+            utils::putU64(out, words[j]);
+        }
+    }
+}
+
+Bitmap Bitmap::decompress(std::string_view data) {
+    if (data.size() < 4 || (data.size() - 4) % 8 != 0) {
+        throw runtime_error("corrupt bitmap");
+    }
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    size_t n = utils::getU32(p), m = (data.size() - 4) / 8;
+    auto word = [p](size_t i) { return utils::getU64(p + 4 + 8 * i); };
+    Bitmap b;
+    b.words.reserve(n);
+    for (size_t i = 0; i != m;) {
+        uint64_t marker = word(i++);
+        uint64_t run = marker >> 1 & maxRun, literals = marker >> 33;
+        if (run > n - b.words.size() ||
+            literals > n - b.words.size() - run || literals > m - i) {
+            throw runtime_error("corrupt bitmap");
+        }
+        b.words.insert(b.words.end(), run, marker & 1 ? ones : 0);
+        for (; literals != 0; --literals) {
+            b.words.push_back(word(i++));
+        }
+    }
+    if (b.words.size() != n) {
+        throw runtime_error("corrupt bitmap");
+    }
+    return b;
+}
+
+bool Reachable::contains(Kind kind, const string &id) const {
+    uint32_t pos = bitmaps->find(kind, id);
+    if (pos != Bitmaps::none) {
+        return bits.test(pos);
+    }
+    return extra[kind].count(id) != 0;
+}
+
+size_t Reachable::count(Kind kind) const {
+    size_t n = extra[kind].size();
+    bits.forEach([&](size_t pos) { n += bitmaps->getKind(pos) == kind; });
+    return n;
+}
+
+void Reachable::forEach(
+    Kind kind, const std::function<void(const string &)> &f) const {
+    bits.forEach([&](size_t pos) {
+        if (bitmaps->getKind(pos) == kind) {
+            f(bitmaps->getID(pos));
+        }
+    });
+    for (const auto &id : extra[kind]) {
+        f(id);
+    }
+}
+
+void Reachable::subtract(const Reachable &other) {
+    bits.andNot(other.bits);
+    for (int kind = 0; kind != kindCount; ++kind) {
+        for (const auto &id : other.extra[kind]) {
+            extra[kind].erase(id);
+        }
+    }
+}
+
+// adds what's reachable from commits and blobs to a Reachable, from many
+// threads
+struct bitmap::Walk {
+    Reachable &r;
+    bool objects;  // not only the commits
+    unordered_map<string, vector<string>> *deps;  // chunks and bases of blobs
+    std::mutex mutex;
+
+    // add an object, return false if it's reachable already
+    bool add(Kind kind, const string &id) {
+        uint32_t pos = r.bitmaps->find(kind, id);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pos == Bitmaps::none) {
+            return r.extra[kind].insert(id).second;
+        } else if (r.bits.test(pos)) {
+            return false;
+        }
+        r.bits.set(pos);
+        return true;
+    }
+
+    void commit(const string &id) {
+        if (!add(commitKind, id) || !objects) {
+            return;
+        }
+        auto c = Commit::load(id);
+        if (!c->getTree().empty()) {
+            tree(string(c->getTree()));
+            return;
+        }
+        for (const auto &file : c->getFiles()) {
+            blob(string(file.second));
+        }
+    }
+
+    // subtrees reachable already are skipped with all they hold
+    void tree(const string &id) {
+        if (!add(treeKind, id)) {
+            return;
+        }
+        auto t = Tree::load(id);
+        for (size_t i = 0; i != t->size(); ++i) {
+            Tree::Entry entry = t->getEntry(i);
+            if (entry.first.back() == '/') {
+                tree(string(entry.second));
+            } else {
+                blob(string(entry.second));
+            }
+        }
+    }
+
+    void blob(const string &id) {
+        if (!add(blobKind, id)) {
+            return;
+        }
+        Blob b;
+        utils::loadObject(b, Blob::getDir(), id);
+        vector<string> next = b.getChunks();
+        if (!b.getBase().empty()) {
+            next.push_back(b.getBase());
+        }
+        if (deps && !next.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            (*deps)[id] = next;
+        }
+        for (const auto &n : next) {
+            blob(n);
+        }
+    }
+};
+
+Bitmaps::Bitmaps() {
+    if (!fs::exists(file)) {
+        return;
+    }
+    mapped = utils::MappedFile(file);
+    data = std::string_view(reinterpret_cast<const char *>(mapped.data()),
+                            mapped.size());
+    parse();
+}
+
+Bitmaps::Bitmaps(string table) : built(std::move(table)) {
+    data = built;
+    parse();
+}
+
+void Bitmaps::parse() {
+    if (data.empty()) {
+        return;
+    }
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    if (data.size() < headerSize || data.substr(0, 4) != magic ||
+        utils::getU32(p + 4) != version) {
+        throw runtime_error("corrupt bitmap file");
+    }
+    count = utils::getU32(p + 8);
+    size_t bitmaps = utils::getU32(p + 12);
+    size_t pos = headerSize + count * entrySize;
+    if (pos > data.size()) {
+        throw runtime_error("corrupt bitmap file");
+    }
+    for (size_t i = 0; i != bitmaps; ++i) {
+        if (data.size() - pos < 8) {
+            throw runtime_error("corrupt bitmap file");
+        }
+        uint32_t commit = utils::getU32(p + pos);
+        uint32_t size = utils::getU32(p + pos + 4);
+        pos += 8;
+        if (commit >= count || data.size() - pos < size) {
+            throw runtime_error("corrupt bitmap file");
+        }
+        stored[commit] = data.substr(pos, size);
+        pos += size;
+    }
+}
+
+uint32_t Bitmaps::find(Kind kind, const string &id) const {
+    string key;
+    if (count == 0 || id.size() != 2 * idSize || !utils::fromHex(id, key)) {
+        return none;
+    }
+    key.push_back(char(kind));
+    const char *entries = data.data() + headerSize;
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp(entries + mid * entrySize, key.data(), entrySize) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == count ||
+        memcmp(entries + lo * entrySize, key.data(), entrySize) != 0) {
+        return none;
+    }
+    return lo;
+}
+
+bitmap::Kind Bitmaps::getKind(size_t pos) const {
+    return Kind(data[headerSize + pos * entrySize + idSize]);
+}
+
+string Bitmaps::getID(size_t pos) const {
+    return utils::toHex(data.substr(headerSize + pos * entrySize, idSize));
+}
+
+Reachable Bitmaps::reachable(const vector<string> &commits,
+                             const vector<string> &blobs) const {
+    return walk(commits, blobs, true, nullptr);
+}
+
+Reachable Bitmaps::commits(const vector<string> &commits) const {
+    return walk(commits, {}, false, nullptr);
+}
+
+// the bitmaps of the commits that have one, the objects of the others
+Reachable Bitmaps::walk(const vector<string> &commits,
+                        const vector<string> &blobs, bool objects,
+                        unordered_map<string, vector<string>> *deps) const {
+    trace::Scope scope("reachable");
+    Reachable r;
+    r.bitmaps = this;
+    Walk w{r, objects, deps};
+    CommitGraph graph;
+    vector<uint32_t> pending;
+    for (const auto &id : commits) {
+        pending.push_back(graph.lookup(id));
+    }
+    vector<bool> visited(graph.size());
+    vector<string> walked;
+    string id;
+    while (!pending.empty()) {
+        uint32_t pos = pending.back();
+        pending.pop_back();
+        if (pos == CommitGraph::none || visited[pos]) {
+            continue;
+        }
+        visited[pos] = true;
+        graph.getID(pos, id);
+        auto iter = stored.find(find(commitKind, id));
+        if (iter != stored.end()) {
+            r.bits |= Bitmap::decompress(iter->second);
+            continue;
+        }
+        walked.push_back(id);
+        pending.push_back(graph.getParent1(pos));
+        pending.push_back(graph.getParent2(pos));
+    }
+    utils::parallelFor(walked.size(),
+                       [&](size_t i) { w.commit(walked[i]); });
+    utils::parallelFor(blobs.size(), [&](size_t i) { w.blob(blobs[i]); });
+    return r;
+}
+
+void Bitmaps::write(const vector<string> &tips) {
+    trace::Scope scope("bitmap");
+    // every reachable object and the chunks and bases of the blobs, walked
+    // without bitmaps
+    Bitmaps empty{string()};
+    unordered_map<string, vector<string>> deps;
+    Reachable all = empty.walk(tips, {}, true, &deps);
+    vector<string> entries;
+    string raw;
+    for (int kind = 0; kind != kindCount; ++kind) {
+        for (const auto &id : all.extra[kind]) {
+            utils::fromHex(id, raw);
+            entries.push_back(raw + char(kind));
+        }
+    }
+    sort(entries.begin(), entries.end());
+    string table(magic, 4);
+    utils::putU32(table, version);
+    utils::putU32(table, entries.size());
+    utils::putU32(table, 0);  // bitmaps, set below
+    for (const auto &e : entries) {
+        table.append(e);
+    }
+    Bitmaps index(std::move(table));
+
+    // a commit's bitmap is those of its parents with what it adds, so
+    // commits go by generation and a bitmap is kept until its last child
+    CommitGraph graph;
+    vector<uint32_t> order;
+    for (const auto &id : all.extra[commitKind]) {
+        order.push_back(graph.lookup(id));
+    }
+    sort(order.begin(), order.end(), [&graph](uint32_t a, uint32_t b) {
+        return graph.getGeneration(a) < graph.getGeneration(b);
+    });
+    unordered_map<uint32_t, unsigned> children;
+    for (uint32_t pos : order) {
+        for (uint32_t parent : {graph.getParent1(pos), graph.getParent2(pos)}) {
+            if (parent != CommitGraph::none) {
+                ++children[parent];
+            }
+        }
+    }
+    std::unordered_set<uint32_t> selected;
+    for (const auto &id : tips) {
+        selected.insert(graph.lookup(id));
+    }
+    Bitmap *cur = nullptr;
+    auto set = [&](Kind kind, const string &id) {
+        uint32_t pos = index.find(kind, id);
+        if (pos == none) {
+            throw runtime_error("object missing from the bitmap table");
+        } else if (cur->test(pos)) {
+            return false;
+        }
+        cur->set(pos);
+        return true;
+    };
+    std::function<void(const string &)> addBlob = [&](const string &id) {
+        if (set(blobKind, id)) {
+            auto iter = deps.find(id);
+            if (iter != deps.end()) {
+                for (const auto &dep : iter->second) {
+                    addBlob(dep);
+                }
+            }
+        }
+    };
+    std::function<void(const string &)> addTree = [&](const string &id) {
+        if (!set(treeKind, id)) {
+            return;
+        }
+        auto t = Tree::load(id);
+        for (size_t i = 0; i != t->size(); ++i) {
+            Tree::Entry entry = t->getEntry(i);
+            if (entry.first.back() == '/') {
+                addTree(string(entry.second));
+            } else {
+                addBlob(string(entry.second));
+            }
+        }
+    };
+    unordered_map<uint32_t, Bitmap> live;  // of commits with children left
+    string bitmaps, id;
+    uint32_t written = 0;
+    for (uint32_t pos : order) {
+        Bitmap b;
+        for (uint32_t parent : {graph.getParent1(pos), graph.getParent2(pos)}) {
+            if (parent == CommitGraph::none) {
+                continue;
+            }
+            auto iter = live.find(parent);
+            if (--children[parent] != 0) {
+                b |= iter->second;
+            } else {
+                // the last child takes the bitmap over
+                iter->second |= b;
+                b = std::move(iter->second);
+                live.erase(iter);
+            }
+        }
+        cur = &b;
+        graph.getID(pos, id);
+        set(commitKind, id);
+        auto c = Commit::load(id);
+        if (!c->getTree().empty()) {
+            addTree(string(c->getTree()));
+        } else {
+            for (const auto &file : c->getFiles()) {
+                addBlob(string(file.second));
+            }
+        }
+        if (selected.count(pos) || graph.getGeneration(pos) % interval == 0) {
+            string compressed;
+            b.compress(compressed);
+            utils::putU32(bitmaps, index.find(commitKind, id));
+            utils::putU32(bitmaps, compressed.size());
+            bitmaps.append(compressed);
+            ++written;
+        }
+        if (children[pos] != 0) {
+            live[pos] = std::move(b);
+        }
+    }
+    string content = std::move(index.built);
+    string count;
+    utils::putU32(count, written);
+    content.replace(12, 4, count);
+    content.append(bitmaps);
+    fs::path tmp = utils::tempFile(file.parent_path());
+    utils::writeFile(tmp, content);
+    utils::replaceFile(tmp, file);
+}
@@ -0,0 +1,124 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "utils.h"
+
+namespace gitlet {
+namespace bitmap {
+// A set of positions, one bit each in 64-bit words. It's stored compressed
+// as EWAH: a marker word tells how many words of all 0 or all 1 bits come
+// next (the bit, then a 32-bit count) and how many literal words follow it
+// (31 bits), so long runs of positions in or out of the set take one word.
+class Bitmap {
+  public:
+    void set(std::size_t pos);
+    bool test(std::size_t pos) const;
+    std::size_t count() const;
+    Bitmap &operator|=(const Bitmap &other);
+    // remove the positions set in other
+    void andNot(const Bitmap &other);
+    // call f with each position set, in order
+    void forEach(const std::function<void(std::size_t)> &f) const;
+    // append the compressed words to out
+    void compress(std::string &out) const;
+    // bitmap of compressed words; if they're malformed, throw a runtime_error
+    static Bitmap decompress(std::string_view data);
+
+  private:
+    std::vector<std::uint64_t> words;
+};
+
+// kinds of objects, each kept in its own object directory
+enum Kind { commitKind, treeKind, blobKind, kindCount };
+
+class Bitmaps;
+struct Walk;
+
+// Objects reachable from some commits: the commits, their trees and blobs,
+// and the chunks and bases of deltas it takes to read the blobs. Those in
+// the object table of the bitmap file are bits of a bitmap, the ids of the
+// others are listed.
+class Reachable {
+  public:
+    bool contains(Kind kind, const std::string &id) const;
+    std::size_t count(Kind kind) const;
+    // call f with the id of each reachable object of a kind
+    void forEach(Kind kind,
+                 const std::function<void(const std::string &)> &f) const;
+    // remove the objects of other, from the same Bitmaps
+    void subtract(const Reachable &other);
+
+  private:
+    const Bitmaps *bitmaps = nullptr;
+    Bitmap bits;
+    std::unordered_set<std::string> extra[kindCount];
+
+    friend class Bitmaps;
+    friend struct Walk;
+};
+
+// The bitmap file ".gitlet/bitmap" answers which objects are reachable from
+// a commit with bitwise operations rather than by walking history. Written by
+// repack for the branch tips and every 32nd generation of their history:
+//   header:  "GBMP", version, number of objects, number of bitmaps (u32
+//            each)
+//   objects: binary id and kind of each object reachable from the branches,
+//            sorted by id and kind
+//   bitmaps: position of a commit in the objects, number of bytes of its
+//            bitmap (u32 each), then the compressed bitmap of the objects
+//            reachable from it
+// The commits made since have no bitmap, they're walked down to commits
+// that have one.
+class Bitmaps {
+  public:
+    static const std::uint32_t none = 0xffffffff;  // no such object
+    // map the bitmap file if it exists; if it's corrupt, throw a
+    // runtime_error
+    Bitmaps();
+    static std::filesystem::path getFile() { return file; }
+    // objects reachable from commits and from blobs
+    Reachable reachable(const std::vector<std::string> &commits,
+                        const std::vector<std::string> &blobs = {}) const;
+    // only the commits reachable from commits
+    Reachable commits(const std::vector<std::string> &commits) const;
+    // write the bitmap file of the objects reachable from tips
+    static void write(const std::vector<std::string> &tips);
+
+  private:
+    utils::MappedFile mapped;
+    std::string built;       // the bytes of a table built in memory
+    std::string_view data;   // mapped or built
+    std::size_t count = 0;   // objects in the table
+    std::unordered_map<std::uint32_t, std::string_view>
+        stored;  // compressed bitmap of each commit position that has one
+    static const std::filesystem::path file;
+
+    explicit Bitmaps(std::string table);
+    void parse();
+    // position of an object in the table, or none
+    std::uint32_t find(Kind kind, const std::string &id) const;
+    Kind getKind(std::size_t pos) const;
+    std::string getID(std::size_t pos) const;
+    // the objects reachable from commits and blobs, or only the commits;
+    // deps, if given, gets the chunks and bases of the blobs walked
+    Reachable walk(
+        const std::vector<std::string> &commits,
+        const std::vector<std::string> &blobs, bool objects,
+        std::unordered_map<std::string, std::vector<std::string>> *deps) const;
+
+    friend class Reachable;
+    friend struct Walk;
+};
+}  // namespace bitmap
+}  // namespace gitlet
+
+#endif /* ifndef BITMAP_H */
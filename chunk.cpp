@@ -0,0 +1,52 @@
+#include "chunk.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+namespace chunk = gitlet::chunk;
+using std::size_t;
+using std::uint64_t;
+
+// a random value for each byte, the same in every run since cut points must
+// not change
+static const std::array<uint64_t, 256> gear = [] {
+    std::array<uint64_t, 256> table;
+    uint64_t x = 0x9e3779b97f4a7c15;
+    for (auto &v : table) {
+        // splitmix64
+        uint64_t z = (x += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        v = z ^ (z >> 31);
+    }
+    return table;
+}();
+
+// the top bits of the hash depend on the last 64 bytes; two bits more than
+// log2(avgSize) before the average size, two less after it
+static const uint64_t smallMask = ~uint64_t(0) << (64 - 18);
+static const uint64_t largeMask = ~uint64_t(0) << (64 - 14);
+
+size_t chunk::cut(std::string_view data) {
+    size_t n = std::min(data.size(), maxSize);
+    if (n <= minSize) {
+        return n;
+    }
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    size_t normal = std::min(n, avgSize);
+    uint64_t hash = 0;
+    size_t i = minSize;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + gear[p[i]];
+        if (!(hash & smallMask)) {
+            return i + 1;
+        }
+    }
+    for (; i < n; ++i) {
+        hash = (hash << 1) + gear[p[i]];
+        if (!(hash & largeMask)) {
+            return i + 1;
+        }
+    }
+    return n;
+}
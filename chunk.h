@@ -0,0 +1,24 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+#include <cstddef>
+#include <string_view>
+
+namespace gitlet {
+namespace chunk {
+// Content-defined chunking in the style of FastCDC: a gear hash rolls over
+// the bytes and a chunk ends where the top bits of the hash are zero, so cut
+// points only depend on the bytes just before them and an edit only changes
+// the chunks around it. Up to avgSize a stricter mask is used and past it a
+// looser one, which keeps chunk sizes close to avgSize.
+const std::size_t minSize = 1 << 14;
+const std::size_t avgSize = 1 << 16;
+const std::size_t maxSize = 1 << 18;
+
+// length of the first chunk of data, between minSize and maxSize unless data
+// is shorter; only the first maxSize bytes are looked at, so pass at least
+// that many unless they're the last ones
+std::size_t cut(std::string_view data);
+}  // namespace chunk
+}  // namespace gitlet
+
+#endif /* ifndef CHUNK_H */
@@ -0,0 +1,299 @@
+#include "codec.h"
+
+#include "config.h"
+#include "utils.h"
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+namespace codec = gitlet::codec;
+namespace fs = std::filesystem;
+namespace utils = gitlet::utils;
+using codec::Codec;
+using codec::Settings;
+using std::runtime_error;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint32_t;
+using std::uint64_t;
+
+static const char magic[] = "GCD";
+static const size_t headerSize = 12;  // magic, codec, decoded size
+static const unsigned lzHashBits = 14;
+static const size_t lzMinMatch = 4;
+
+static string header(Codec c, uint64_t size) {
+    string s(magic, 3);
+    s.push_back(char(c));
+    utils::putU64(s, size);
+    return s;
+}
+
+// whether encoded bytes save enough space to be worth decoding them
+static bool worth(size_t encoded, size_t size) {
+    return encoded + size / 8 <= size;
+}
+
+static uint64_t getVarint(string_view s, size_t &pos) {
+    uint64_t v;
+    if (!utils::getVarint(s, pos, v)) {
+        throw runtime_error("corrupt object");
+    }
+    return v;
+}
+
+// LZ77 over one block: (literal length, literals, offset, match length - 4)
+// sequences, matches found through a hash table of the last position of
+// every 4-byte sequence, an offset of 0 ends the block
+static void lzBlock(string_view in, string &out) {
+    std::vector<uint32_t> table(size_t(1) << lzHashBits);  // position + 1
+    size_t pos = 0, anchor = 0, n = in.size();
+    while (pos + lzMinMatch <= n) {
+        uint32_t seq;
+        memcpy(&seq, in.data() + pos, 4);
+        uint32_t h = (seq * 2654435761u) >> (32 - lzHashBits);
+        size_t cand = table[h];
+        table[h] = pos + 1;
+        if (cand == 0 || memcmp(in.data() + cand - 1, in.data() + pos, 4)) {
+            ++pos;
+            continue;
+        }
+        --cand;
+        size_t length = lzMinMatch;
+        while (pos + length < n && in[cand + length] == in[pos + length]) {
+            ++length;
+        }
+        utils::putVarint(out, pos - anchor);
+        out.append(in.substr(anchor, pos - anchor));
+        utils::putVarint(out, pos - cand);
+        utils::putVarint(out, length - lzMinMatch);
+        pos = anchor = pos + length;
+    }
+    utils::putVarint(out, n - anchor);
+    out.append(in.substr(anchor));
+    utils::putVarint(out, 0);
+}
+
+// decode a block made by lzBlock() into dst, which has room for size bytes
+static void unlzBlock(string_view in, char *dst, size_t size) {
+    size_t pos = 0, done = 0;
+    while (true) {
+        uint64_t literal = getVarint(in, pos);
+        if (literal > in.size() - pos || literal > size - done) {
+            throw runtime_error("corrupt object");
+        }
+        memcpy(dst + done, in.data() + pos, literal);
+        pos += literal;
+        done += literal;
+        uint64_t offset = getVarint(in, pos);
+        if (offset == 0) {
+            break;
+        }
+        uint64_t length = getVarint(in, pos) + lzMinMatch;
+        if (offset > done || length > size - done) {
+            throw runtime_error("corrupt object");
+        }
+        const char *from = dst + done - offset;
+        if (offset >= length) {
+            memcpy(dst + done, from, length);
+        } else {  // the match overlaps what it produces
+            for (size_t i = 0; i != length; ++i) {
+                dst[done + i] = from[i];
+            }
+        }
+        done += length;
+    }
+    if (done != size || pos != in.size()) {
+        throw runtime_error("corrupt object");
+    }
+}
+
+namespace {
+// compresses the pieces of an object one after another
+class Encoder {
+  public:
+    explicit Encoder(const Settings &s) : codec(s.codec) {
+        if (codec == codec::zlib && deflateInit(&zs, s.level) != Z_OK) {
+            throw runtime_error("cannot initialize zlib");
+        }
+    }
+    ~Encoder() {
+        if (codec == codec::zlib) {
+            deflateEnd(&zs);
+        }
+    }
+    Encoder(const Encoder &) = delete;
+    Encoder &operator=(const Encoder &) = delete;
+    // append the encoding of the next piece to out
+    void update(string_view in, bool last, string &out) {
+        if (codec == codec::lz) {
+            // blocks: decoded size, encoded size or 0 if stored, the bytes
+            for (size_t off = 0; off < in.size(); off += utils::chunkSize) {
+                string_view block = in.substr(off, utils::chunkSize);
+                string encoded;
+                lzBlock(block, encoded);
+                utils::putVarint(out, block.size());
+                if (encoded.size() < block.size()) {
+                    utils::putVarint(out, encoded.size());
+                    out.append(encoded);
+                } else {
+                    utils::putVarint(out, 0);
+                    out.append(block);
+                }
+            }
+            return;
+        }
+        zs.next_in = (Bytef *)in.data();
+        zs.avail_in = in.size();
+        char buf[16384];
+        int ret;
+        do {
+            zs.next_out = (Bytef *)buf;
+            zs.avail_out = sizeof(buf);
+            ret = deflate(&zs, last ? Z_FINISH : Z_NO_FLUSH);
+            if (ret == Z_STREAM_ERROR) {
+                throw runtime_error("cannot compress the object");
+            }
+            out.append(buf, sizeof(buf) - zs.avail_out);
+        } while (zs.avail_out == 0 || (last && ret != Z_STREAM_END));
+    }
+
+  private:
+    Codec codec;
+    z_stream zs{};
+};
+}  // namespace
+
+static Settings current;
+
+Settings codec::readSettings() {
+    utils::Config config;
+    Settings s;
+    string name = config.get("compression", "zlib");
+    if (name == "none") {
+        s.codec = raw;
+    } else if (name == "zlib") {
+        s.codec = zlib;
+    } else if (name == "lz") {
+        s.codec = lz;
+    } else {
+        throw runtime_error("unknown compression " + name);
+    }
+    s.level = config.getInt("compression.level", s.level);
+    if (s.level < 1 || s.level > 9) {
+        throw runtime_error("compression.level must be from 1 to 9");
+    }
+    return s;
+}
+
+void codec::setSettings(const Settings &s) { current = s; }
+
+void codec::loadSettings() { setSettings(readSettings()); }
+
+const Settings &codec::settings() { return current; }
+
+bool codec::encode(string_view data, string &out, const Settings &s) {
+    if (s.codec == raw || data.size() < minSize) {
+        return false;
+    }
+    string encoded = header(s.codec, data.size());
+    Encoder(s).update(data, true, encoded);
+    if (!worth(encoded.size(), data.size())) {
+        return false;
+    }
+    out = std::move(encoded);
+    return true;
+}
+
+void codec::encodeFile(const fs::path &file, const Settings &s) {
+    uint64_t size = fs::file_size(file);
+    if (s.codec == raw || size < minSize) {
+        return;
+    }
+    std::ifstream is(file, std::ios::binary);
+    fs::path tmp = utils::tempFile(file.parent_path());
+    std::ofstream os(tmp, std::ios::binary);
+    if (!is.is_open() || !os.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    Encoder encoder(s);
+    string out = header(s.codec, size);
+    uint64_t read = 0, written = 0;
+    std::unique_ptr<char[]> buf(new char[utils::chunkSize]);
+    while (is.read(buf.get(), utils::chunkSize) || is.gcount() > 0) {
+        read += is.gcount();
+        encoder.update(string_view(buf.get(), is.gcount()), read == size,
+                       out);
+        os.write(out.data(), out.size());
+        written += out.size();
+        out.clear();
+    }
+    os.close();
+    if (read != size || !os) {
+        fs::remove(tmp);
+        throw runtime_error("cannot write the file");
+    }
+    if (worth(written, size)) {
+        fs::rename(tmp, file);
+    } else {
+        fs::remove(tmp);
+    }
+}
+
+Codec codec::codecOf(string_view stored) {
+    if (stored.size() < headerSize || memcmp(stored.data(), magic, 3) != 0) {
+        return raw;
+    }
+    Codec c = Codec(stored[3]);
+    if (c != zlib && c != lz) {
+        throw runtime_error("unknown codec of the object");
+    }
+    return c;
+}
+
+bool codec::decode(string_view stored, string &out) {
+    Codec c = codecOf(stored);
+    if (c == raw) {
+        return false;
+    }
+    uint64_t size =
+        utils::getU64(reinterpret_cast<const unsigned char *>(stored.data()) +
+                      4);
+    string_view in = stored.substr(headerSize);
+    out.resize(size);
+    if (c == zlib) {
+        uLongf length = size;
+        if (uncompress((Bytef *)out.data(), &length, (const Bytef *)in.data(),
+                       in.size()) != Z_OK ||
+            length != size) {
+            throw runtime_error("corrupt object");
+        }
+        return true;
+    }
+    size_t pos = 0, done = 0;
+    while (pos < in.size()) {
+        uint64_t blockSize = getVarint(in, pos);
+        uint64_t encoded = getVarint(in, pos);
+        uint64_t length = encoded == 0 ? blockSize : encoded;
+        if (blockSize > size - done || length > in.size() - pos) {
+            throw runtime_error("corrupt object");
+        }
+        if (encoded == 0) {
+            memcpy(out.data() + done, in.data() + pos, blockSize);
+        } else {
+            unlzBlock(in.substr(pos, encoded), out.data() + done, blockSize);
+        }
+        pos += length;
+        done += blockSize;
+    }
+    if (done != size) {
+        throw runtime_error("corrupt object");
+    }
+    return true;
+}
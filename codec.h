@@ -0,0 +1,58 @@
+#ifndef CODEC_H
+#define CODEC_H
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace gitlet {
+namespace codec {
+// Compression of stored objects. An encoded object starts with a header:
+//   magic "GCD", codec, size of the decoded bytes (u64)
+// followed by the compressed bytes. Objects stored raw have no header (they
+// are boost archives, which never start with the magic), so repositories
+// mixing codecs, or written before compression, stay readable.
+enum Codec : unsigned char {
+    raw = 0,
+    zlib = 1,  // deflate, level 1 to 9
+    lz = 2,    // in-tree LZ77, fast to decode, no level
+};
+
+// codec of new objects, from "compression = none | zlib | lz" and
+// "compression.level = <n>" in the config file, zlib level 6 by default
+struct Settings {
+    Codec codec = zlib;
+    int level = 6;
+};
+// the settings in the config file; if they're malformed, throw a
+// runtime_error
+Settings readSettings();
+// encode the objects of the commands that follow with s
+void setSettings(const Settings &s);
+// read the settings from the config file once for a command, rather than for
+// every object it saves
+void loadSettings();
+// the settings set last
+const Settings &settings();
+
+// objects smaller than this are always stored raw
+const std::size_t minSize = 512;
+
+// encode bytes to be stored with the given settings, return false and leave
+// out untouched if they are too small or don't compress well, so they should
+// be stored raw
+bool encode(std::string_view data, std::string &out,
+            const Settings &s = settings());
+// encode a file in place, reading it chunk by chunk, unless it should be
+// stored raw
+void encodeFile(const std::filesystem::path &file,
+                const Settings &s = settings());
+// codec of stored bytes
+Codec codecOf(std::string_view stored);
+// decode stored bytes into out, return false if they're raw; if they're
+// corrupt, throw a runtime_error
+bool decode(std::string_view stored, std::string &out);
+}  // namespace codec
+}  // namespace gitlet
+
+#endif /* ifndef CODEC_H */
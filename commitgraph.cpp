@@ -0,0 +1,402 @@
+#include "commitgraph.h"
+
+#include "gitletobj.h"
+#include "journal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+using namespace gitlet::gitlet_obj;
+using std::int64_t;
+using std::runtime_error;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::vector;
+
+namespace utils = gitlet::utils;
+namespace fs = std::filesystem;
+
+const std::filesystem::path CommitGraph::file = ".gitlet/commit-graph";
+const std::filesystem::path CommitGraph::countFile =
+    ".gitlet/commit-graph-count";
+
+static const char magic[] = "GCGR";
+static const uint32_t version = 1;
+static const size_t idSize = 20;
+static const size_t fanoutOffset = 12;  // after magic, version, sorted
+
+// header of a file whose sorted records have the given first bytes
+static string header(const vector<unsigned char> &firstBytes) {
+    string s(magic, 4);
+    utils::putU32(s, version);
+    utils::putU32(s, firstBytes.size());
+    size_t count = 0;
+    for (unsigned b = 0; b != 256; ++b) {
+        while (count != firstBytes.size() && firstBytes[count] == b) {
+            ++count;
+        }
+        utils::putU32(s, count);
+    }
+    return s;
+}
+
+static string makeRecord(const string &id, uint32_t parent1, uint32_t parent2,
+                         uint32_t generation, int64_t time) {
+    string r = id;
+    utils::putU32(r, parent1);
+    utils::putU32(r, parent2);
+    utils::putU32(r, generation);
+    utils::putU64(r, time);
+    return r;
+}
+
+CommitGraph::CommitGraph() { load(); }
+
+// map the file, or the temp file replacing it in the current transaction
+void CommitGraph::load() {
+    fs::path current = utils::currentPath(file);
+    if (!fs::exists(current)) {
+        return;
+    }
+    mapped = utils::MappedFile(current);
+    if (mapped.size() < headerSize || memcmp(mapped.data(), magic, 4) != 0 ||
+        utils::getU32(mapped.data() + 4) != version) {
+        throw runtime_error("corrupt commit-graph file");
+    }
+    sorted = utils::getU32(mapped.data() + 8);
+    mappedCount = (mapped.size() - headerSize) / recordSize;
+    if (sorted > mappedCount) {
+        throw runtime_error("corrupt commit-graph file");
+    }
+    // records past the count were appended by a command that didn't commit,
+    // a count below the sorted records is older than the file written again
+    fs::path count = utils::currentPath(countFile);
+    if (fs::exists(count)) {
+        string bytes = utils::readFile(count);
+        if (bytes.size() != 4) {
+            throw runtime_error("corrupt commit-graph file");
+        }
+        auto *p = reinterpret_cast<const unsigned char *>(bytes.data());
+        mappedCount = std::clamp<size_t>(utils::getU32(p), sorted, mappedCount);
+    }
+    for (size_t pos = sorted; pos != mappedCount; ++pos) {
+        unsorted[string(reinterpret_cast<const char *>(record(pos)), idSize)] =
+            pos;
+    }
+}
+
+const unsigned char *CommitGraph::record(uint32_t pos) const {
+    if (pos < mappedCount) {
+        return mapped.data() + headerSize + size_t(pos) * recordSize;
+    }
+    return reinterpret_cast<const unsigned char *>(added.data()) +
+           (pos - mappedCount) * recordSize;
+}
+
+size_t CommitGraph::lowerBound(const string &key) const {
+    if (sorted == 0) {
+        return 0;
+    }
+    auto fanout = [this](unsigned b) {
+        return utils::getU32(mapped.data() + fanoutOffset + 4 * b);
+    };
+    unsigned char first = key[0];
+    size_t lo = first == 0 ? 0 : fanout(first - 1), hi = fanout(first);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp(record(mid), key.data(), idSize) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+uint32_t CommitGraph::find(const string &id) const {
+    string key;
+    if (id.size() != 2 * idSize || !utils::fromHex(id, key)) {
+        return none;
+    }
+    size_t pos = lowerBound(key);
+    if (pos != sorted && memcmp(record(pos), key.data(), idSize) == 0) {
+        return pos;
+    }
+    auto iter = unsorted.find(key);
+    return iter == unsorted.end() ? none : iter->second;
+}
+
+vector<string> CommitGraph::matchPrefix(const string &prefix) const {
+    string key;
+    vector<string> ids;
+    if (prefix.empty() || prefix.size() > 2 * idSize ||
+        !utils::fromHex(prefix + string(2 * idSize - prefix.size(), '0'),
+                        key)) {
+        return ids;
+    }
+    string upper = prefix;
+    for (char &c : upper) {
+        c = std::toupper(static_cast<unsigned char>(c));
+    }
+    for (size_t pos = lowerBound(key); pos != sorted; ++pos) {
+        string id = getID(pos);
+        if (id.compare(0, upper.size(), upper) != 0) {
+            break;
+        }
+        ids.push_back(id);
+    }
+    for (const auto &i : unsorted) {
+        string id = getID(i.second);
+        if (id.compare(0, upper.size(), upper) == 0) {
+            ids.push_back(id);
+        }
+    }
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+uint32_t CommitGraph::lookup(const string &id) {
+    uint32_t pos = find(id);
+    if (pos != none) {
+        return pos;
+    }
+    // add missing ancestors before their descendants, without recursion so
+    // long histories don't overflow the stack
+    vector<string> pending = {id};
+    while (!pending.empty()) {
+        string cur = pending.back();
+        if (find(cur) != none) {
+            pending.pop_back();
+            continue;
+        }
+        auto c = Commit::load(cur);
+        bool ready = true;
+        for (std::string_view p : {c->getParent1(), c->getParent2()}) {
+            string parent(p);
+            if (!parent.empty() && find(parent) == none) {
+                pending.push_back(parent);
+                ready = false;
+            }
+        }
+        if (ready) {
+            add(*c);
+            pending.pop_back();
+        }
+    }
+    return find(id);
+}
+
+uint32_t CommitGraph::add(const Commit &c) {
+    uint32_t pos = find(c.getID());
+    if (pos != none) {
+        return pos;
+    }
+    string par1(c.getParent1());
+    string par2(c.getParent2());
+    uint32_t parent1 = par1.empty() ? none : lookup(par1);
+    uint32_t parent2 = par2.empty() ? none : lookup(par2);
+    string key;
+    utils::fromHex(c.getID(), key);
+    return append(key, parent1, parent2, c.getTime());
+}
+
+uint32_t CommitGraph::append(const string &id, uint32_t parent1,
+                             uint32_t parent2, int64_t time) {
+    uint32_t generation = 1;
+    for (uint32_t parent : {parent1, parent2}) {
+        if (parent != none) {
+            generation = std::max(generation, getGeneration(parent) + 1);
+        }
+    }
+    string r = makeRecord(id, parent1, parent2, generation, time);
+    uint32_t pos = size();
+    added.append(r);
+    unsorted[id] = pos;
+    return pos;
+}
+
+void CommitGraph::save() {
+    if (added.empty()) {
+        return;
+    }
+    size_t tail = size() - sorted;
+    if (mappedCount == 0 || (tail > 64 && tail * 8 > size())) {
+        fs::path tmp = utils::tempFile(file.parent_path());
+        utils::writeFile(tmp, rewrite());
+        utils::replaceFile(tmp, file);
+    } else {
+        // the new records go after the counted ones, over any a command that
+        // didn't commit left
+        fs::path current = utils::currentPath(file);
+        fs::resize_file(current, headerSize + mappedCount * recordSize);
+        std::ofstream os(current, std::ios::binary | std::ios::app);
+        if (!os.write(added.data(), added.size()) || !os.flush()) {
+            throw runtime_error("cannot write the commit-graph file");
+        }
+        utils::syncFile(current);
+    }
+    // the count is saved through the transaction, so the records of a
+    // command that doesn't commit aren't counted
+    string count;
+    utils::putU32(count, size());
+    fs::path tmp = utils::tempFile(file.parent_path());
+    utils::writeFile(tmp, count);
+    utils::replaceFile(tmp, countFile);
+    mapped = utils::MappedFile();
+    sorted = mappedCount = 0;
+    added.clear();
+    unsorted.clear();
+    load();
+}
+
+// the file with every record sorted, parents are renumbered
+string CommitGraph::rewrite() const {
+    size_t n = size();
+    vector<uint32_t> order(n);
+    for (size_t i = 0; i != n; ++i) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return memcmp(record(a), record(b), idSize) < 0;
+    });
+    vector<uint32_t> newPos(n);
+    for (size_t i = 0; i != n; ++i) {
+        newPos[order[i]] = i;
+    }
+    auto renumber = [&](uint32_t pos) {
+        return pos == none ? none : newPos[pos];
+    };
+    vector<unsigned char> firstBytes;
+    for (uint32_t old : order) {
+        firstBytes.push_back(record(old)[0]);
+    }
+    string content = header(firstBytes);
+    for (uint32_t old : order) {
+        content.append(makeRecord(
+            string(reinterpret_cast<const char *>(record(old)), idSize),
+            renumber(getParent1(old)), renumber(getParent2(old)),
+            getGeneration(old), getTime(old)));
+    }
+    return content;
+}
+
+string CommitGraph::getID(uint32_t pos) const {
+    string id;
+    getID(pos, id);
+    return id;
+}
+
+void CommitGraph::getID(uint32_t pos, string &id) const {
+    utils::toHex(
+        std::string_view(reinterpret_cast<const char *>(record(pos)), idSize),
+        id);
+}
+
+uint32_t CommitGraph::getParent1(uint32_t pos) const {
+    return utils::getU32(record(pos) + idSize);
+}
+
+uint32_t CommitGraph::getParent2(uint32_t pos) const {
+    return utils::getU32(record(pos) + idSize + 4);
+}
+
+uint32_t CommitGraph::getGeneration(uint32_t pos) const {
+    return utils::getU32(record(pos) + idSize + 8);
+}
+
+int64_t CommitGraph::getTime(uint32_t pos) const {
+    return utils::getU64(record(pos) + idSize + 12);
+}
+
+bool CommitGraph::isAncestor(uint32_t ancestor, uint32_t descendant) const {
+    uint32_t floor = getGeneration(ancestor);
+    vector<bool> visited(size());
+    vector<uint32_t> stack = {descendant};
+    while (!stack.empty()) {
+        uint32_t pos = stack.back();
+        stack.pop_back();
+        if (pos == ancestor) {
+            return true;
+        }
+        // nothing below the ancestor's generation can lead to it
+        if (visited[pos] || getGeneration(pos) <= floor) {
+            continue;
+        }
+        visited[pos] = true;
+        for (uint32_t parent : {getParent1(pos), getParent2(pos)}) {
+            if (parent != none) {
+                stack.push_back(parent);
+            }
+        }
+    }
+    return false;
+}
+
+// Walk down from both commits at once, highest generation first, painting
+// each commit with the side(s) it's reachable from. A commit painted by both
+// sides is a common ancestor; everything below it is marked stale and the
+// walk stops once only stale commits are left, so only the history newer
+// than the merge base is visited.
+uint32_t CommitGraph::mergeBase(uint32_t a, uint32_t b) const {
+    if (a == b) {
+        return a;
+    }
+    enum : unsigned char { side1 = 1, side2 = 2, stale = 4, result = 8 };
+    vector<unsigned char> flags(size());
+    // entries are (position, whether it was queued before being stale)
+    typedef std::pair<uint32_t, bool> Entry;
+    auto later = [this](const Entry &x, const Entry &y) {
+        uint32_t gx = getGeneration(x.first), gy = getGeneration(y.first);
+        return gx != gy ? gx < gy : getTime(x.first) < getTime(y.first);
+    };
+    std::priority_queue<Entry, vector<Entry>, decltype(later)> queue(later);
+    size_t active = 2;  // queued entries that were not stale
+    flags[a] |= side1;
+    flags[b] |= side2;
+    queue.push({a, true});
+    queue.push({b, true});
+    vector<uint32_t> candidates;
+    while (active != 0) {
+        auto [pos, counted] = queue.top();
+        queue.pop();
+        if (counted) {
+            --active;
+        }
+        unsigned char paint = flags[pos] & (side1 | side2 | stale);
+        if (paint == (side1 | side2)) {
+            if (!(flags[pos] & result)) {
+                flags[pos] |= result;
+                candidates.push_back(pos);
+            }
+            paint |= stale;
+        }
+        for (uint32_t parent : {getParent1(pos), getParent2(pos)}) {
+            if (parent == none || (flags[parent] & paint) == paint) {
+                continue;
+            }
+            flags[parent] |= paint;
+            bool nonStale = !(paint & stale);
+            queue.push({parent, nonStale});
+            active += nonStale;
+        }
+    }
+    // a candidate reachable from another one is not a best common ancestor
+    for (uint32_t c : candidates) {
+        bool best = true;
+        for (uint32_t other : candidates) {
+            if (other != c && isAncestor(c, other)) {
+                best = false;
+                break;
+            }
+        }
+        if (best) {
+            return c;
+        }
+    }
+    return none;
+}
@@ -0,0 +1,89 @@
+#ifndef COMMITGRAPH_H
+#define COMMITGRAPH_H
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+
+namespace gitlet {
+namespace gitlet_obj {
+class Commit;
+
+// The commit-graph file holds, for every commit, its parents as positions in
+// the file, its generation number (1 for a root commit, otherwise one more
+// than its highest parent) and its commit time, so history can be walked
+// without deserializing commits. Layout:
+//   header: magic, version, number of sorted records
+//   fan-out: for each first byte b, number of sorted records with a first
+//            byte not greater than b
+//   records sorted by id, then records added since they were sorted
+//   record: binary id, parent1, parent2, generation, time
+// The file is memory-mapped; an id is found by binary search in its fan-out
+// bucket of the sorted part or in a hash map of the added part. New records
+// are kept in memory until save() appends them to the file in place, so
+// commands that only read never write it. The number of records is saved in
+// ".gitlet/commit-graph-count" through the current transaction, records past
+// it were appended by a command that didn't commit and are ignored. When the
+// added part grows too long, the whole file is written again with it merged
+// into the sorted part.
+class CommitGraph {
+  public:
+    static const std::uint32_t none = 0xffffffff;  // no such commit
+    // map the commit-graph file if it exists
+    CommitGraph();
+    static std::filesystem::path getFile() { return file; }
+    static std::filesystem::path getCountFile() { return countFile; }
+    std::size_t size() const { return mappedCount + added.size() / recordSize; }
+    // position of a commit, if it's not in the graph yet, load it and its
+    // missing ancestors and add them
+    std::uint32_t lookup(const std::string &id);
+    // position of a commit already in the graph, or none
+    std::uint32_t find(const std::string &id) const;
+    // sorted ids of the commits in the graph starting with a hex prefix
+    std::vector<std::string> matchPrefix(const std::string &prefix) const;
+    // add a commit just created, return its position
+    std::uint32_t add(const Commit &c);
+    // write the commits added, positions taken before may change
+    void save();
+    std::string getID(std::uint32_t pos) const;
+    // the same into id, reusing its memory
+    void getID(std::uint32_t pos, std::string &id) const;
+    std::uint32_t getParent1(std::uint32_t pos) const;
+    std::uint32_t getParent2(std::uint32_t pos) const;
+    std::uint32_t getGeneration(std::uint32_t pos) const;
+    std::int64_t getTime(std::uint32_t pos) const;
+    // whether ancestor can be reached from descendant through parent links,
+    // a commit is its own ancestor
+    bool isAncestor(std::uint32_t ancestor, std::uint32_t descendant) const;
+    // best common ancestor of two commits, or none if they share no history
+    std::uint32_t mergeBase(std::uint32_t a, std::uint32_t b) const;
+
+  private:
+    static const std::size_t headerSize = 12 + 256 * 4;
+    static const std::size_t recordSize = 40;
+    utils::MappedFile mapped;
+    std::size_t sorted = 0;       // records sorted by id at the start
+    std::size_t mappedCount = 0;  // records in the mapped file
+    std::string added;            // records added since the file was read
+    std::unordered_map<std::string, std::uint32_t>
+        unsorted;  // binary id to position of records after the sorted ones
+    static const std::filesystem::path file;
+    static const std::filesystem::path countFile;
+
+    const unsigned char *record(std::uint32_t pos) const;
+    // first sorted position whose id is not less than key, among the ones
+    // sharing its first byte
+    std::size_t lowerBound(const std::string &key) const;
+    std::uint32_t append(const std::string &id, std::uint32_t parent1,
+                         std::uint32_t parent2, std::int64_t time);
+    void load();
+    std::string rewrite() const;
+};
+}  // namespace gitlet_obj
+}  // namespace gitlet
+
+#endif /* ifndef COMMITGRAPH_H */
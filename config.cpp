@@ -0,0 +1,51 @@
+#include "config.h"
+
+#include <fstream>
+#include <stdexcept>
+namespace utils = gitlet::utils;
+using std::runtime_error;
+using std::string;
+
+const std::filesystem::path utils::Config::defaultFile = ".gitlet/config";
+
+static string trim(const string &s) {
+    auto begin = s.find_first_not_of(" \t\r");
+    if (begin == string::npos) {
+        return "";
+    }
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+utils::Config::Config(const std::filesystem::path &file) {
+    std::ifstream is(file);
+    string line;
+    while (std::getline(is, line)) {
+        line = trim(line);
+        auto eq = line.find('=');
+        if (line.empty() || line[0] == '#' || eq == string::npos) {
+            continue;
+        }
+        values[trim(line.substr(0, eq))] = trim(line.substr(eq + 1));
+    }
+}
+
+string utils::Config::get(const string &key, const string &def) const {
+    auto iter = values.find(key);
+    return iter == values.end() ? def : iter->second;
+}
+
+int utils::Config::getInt(const string &key, int def) const {
+    auto iter = values.find(key);
+    if (iter == values.end()) {
+        return def;
+    }
+    try {
+        size_t end;
+        int v = std::stoi(iter->second, &end);
+        if (end == iter->second.size()) {
+            return v;
+        }
+    } catch (const std::logic_error &) {
+    }
+    throw runtime_error("bad value of " + key + " in the config file");
+}
@@ -0,0 +1,29 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace gitlet {
+namespace utils {
+// Settings of the repository in ".gitlet/config", one "key = value" per line,
+// blank lines and lines starting with '#' are ignored.
+class Config {
+  public:
+    // read the config file if it exists
+    explicit Config(const std::filesystem::path &file = defaultFile);
+    static std::filesystem::path getFile() { return defaultFile; }
+    // value of a key, or def if it's not set
+    std::string get(const std::string &key, const std::string &def) const;
+    // integer value of a key, or def if it's not set, if the value is not an
+    // integer, throw a runtime_error
+    int getInt(const std::string &key, int def) const;
+
+  private:
+    std::unordered_map<std::string, std::string> values;
+    static const std::filesystem::path defaultFile;
+};
+}  // namespace utils
+}  // namespace gitlet
+
+#endif /* ifndef CONFIG_H */
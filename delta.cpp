@@ -0,0 +1,117 @@
+#include "delta.h"
+
+#include "utils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+namespace delta = gitlet::delta;
+namespace utils = gitlet::utils;
+using std::runtime_error;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint64_t;
+
+static const size_t blockSize = 16;
+static const unsigned char opInsert = 0;
+static const unsigned char opCopy = 1;
+
+static uint64_t getVarint(string_view s, size_t &pos) {
+    uint64_t v;
+    if (!utils::getVarint(s, pos, v)) {
+        throw runtime_error("corrupt delta");
+    }
+    return v;
+}
+
+static uint64_t hashBlock(const char *p) {
+    uint64_t h = 14695981039346656037ull;  // FNV-1a
+    for (size_t i = 0; i != blockSize; ++i) {
+        h = (h ^ (unsigned char)p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static void flushInsert(string &out, string_view target, size_t from,
+                        size_t to) {
+    if (from != to) {
+        out.push_back(char(opInsert));
+        utils::putVarint(out, to - from);
+        out.append(target.substr(from, to - from));
+    }
+}
+
+string delta::create(string_view base, string_view target) {
+    string out;
+    utils::putVarint(out, base.size());
+    utils::putVarint(out, target.size());
+    // first offset of every aligned block of the base
+    std::unordered_map<uint64_t, size_t> blocks;
+    for (size_t off = 0; off + blockSize <= base.size(); off += blockSize) {
+        blocks.emplace(hashBlock(base.data() + off), off);
+    }
+    size_t pos = 0, literal = 0;
+    while (pos + blockSize <= target.size()) {
+        auto iter = blocks.find(hashBlock(target.data() + pos));
+        if (iter == blocks.end() ||
+            memcmp(base.data() + iter->second, target.data() + pos,
+                   blockSize) != 0) {
+            ++pos;
+            continue;
+        }
+        size_t from = iter->second, to = pos;
+        // extend the match backwards into the pending literal, then forwards
+        while (from > 0 && to > literal && base[from - 1] == target[to - 1]) {
+            --from;
+            --to;
+        }
+        size_t length = pos - to + blockSize;
+        while (from + length < base.size() && to + length < target.size() &&
+               base[from + length] == target[to + length]) {
+            ++length;
+        }
+        flushInsert(out, target, literal, to);
+        out.push_back(char(opCopy));
+        utils::putVarint(out, from);
+        utils::putVarint(out, length);
+        pos = literal = to + length;
+    }
+    flushInsert(out, target, literal, target.size());
+    return out;
+}
+
+string delta::apply(string_view base, string_view delta) {
+    size_t pos = 0;
+    if (getVarint(delta, pos) != base.size()) {
+        throw runtime_error("corrupt delta");
+    }
+    uint64_t size = getVarint(delta, pos);
+    string out;
+    out.reserve(size);
+    while (pos < delta.size()) {
+        unsigned char op = delta[pos++];
+        if (op == opCopy) {
+            uint64_t offset = getVarint(delta, pos);
+            uint64_t length = getVarint(delta, pos);
+            if (offset > base.size() || length > base.size() - offset) {
+                throw runtime_error("corrupt delta");
+            }
+            out.append(base.substr(offset, length));
+        } else if (op == opInsert) {
+            uint64_t length = getVarint(delta, pos);
+            if (length > delta.size() - pos) {
+                throw runtime_error("corrupt delta");
+            }
+            out.append(delta.substr(pos, length));
+            pos += length;
+        } else {
+            throw runtime_error("corrupt delta");
+        }
+    }
+    if (out.size() != size) {
+        throw runtime_error("corrupt delta");
+    }
+    return out;
+}
@@ -0,0 +1,20 @@
+#ifndef DELTA_H
+#define DELTA_H
+#include <string>
+#include <string_view>
+
+namespace gitlet {
+namespace delta {
+// Encode target as instructions against base:
+//   header: size of base, size of target (varints)
+//   copy:   0x01, offset in base, length (varints)
+//   insert: 0x00, length (varint), the literal bytes
+// Matches are found through an index of the base's 16-byte blocks.
+std::string create(std::string_view base, std::string_view target);
+// rebuild the target from base and a delta made by create(), if the delta
+// doesn't fit the base, throw a runtime_error
+std::string apply(std::string_view base, std::string_view delta);
+}  // namespace delta
+}  // namespace gitlet
+
+#endif /* ifndef DELTA_H */
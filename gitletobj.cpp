@@ -1,13 +1,28 @@
 #include "gitletobj.h"
 
+#include "bitmap.h"
+#include "chunk.h"
+#include "codec.h"
+#include "commitgraph.h"
+#include "config.h"
+#include "delta.h"
+#include "index.h"
+#include "journal.h"
+#include "pack.h"
 #include "utils.h"
 
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
+#include <tuple>
 using namespace gitlet::gitlet_obj;
 using std::cout;
 using std::ctime;
@@ -23,74 +38,162 @@ using std::unordered_set;
 using std::vector;
 
 namespace utils = gitlet::utils;
+namespace bitmap = gitlet::bitmap;
+namespace pack = gitlet::pack;
+namespace trace = gitlet::trace;
 namespace fs = std::filesystem;
 
 const std::filesystem::path Gitlet::dir = ".gitlet/info";
 const std::filesystem::path Commit::dir = ".gitlet/commit";
 const std::filesystem::path Blob::dir = ".gitlet/blob";
 
+// add the regular files below dir, recursively, to files as normalized paths;
+// the repository itself is skipped
+static void listWorkingFiles(const fs::path &dir, vector<string> &files) {
+    trace::Scope scope("scan");
+    for (auto iter = fs::recursive_directory_iterator(dir);
+         iter != fs::recursive_directory_iterator(); ++iter) {
+        if (iter->is_directory() && iter->path().filename() == ".gitlet") {
+            iter.disable_recursion_pending();
+        } else if (iter->is_regular_file()) {
+            files.push_back(iter->path().lexically_normal());
+        }
+    }
+}
+
+// a path given to a command as the repository keeps it, relative to the
+// working directory without "." or ".." parts; if it's outside the working
+// files, throw a runtime_error
+static string workingPath(const string &path) {
+    fs::path p = fs::path(path).lexically_normal();
+    if (p.is_absolute()) {
+        p = p.lexically_relative(fs::current_path());
+    }
+    if (!p.has_filename()) {  // "d/" is "d"
+        p = p.parent_path();
+    }
+    if (p.empty() || *p.begin() == "..") {
+        throw runtime_error("Path is outside the repository");
+    } else if (*p.begin() == ".gitlet") {
+        throw runtime_error("Path is inside .gitlet");
+    }
+    return p.string();
+}
+
+// create the directories a working file is in
+static void makeParentDirs(const string &file) {
+    fs::path parent = fs::path(file).parent_path();
+    if (!parent.empty()) {
+        fs::create_directories(parent);
+    }
+}
+
+// remove a working file and the directories it leaves empty
+static void removeWorkingFile(const string &file) {
+    fs::remove(file);
+    std::error_code ec;
+    for (fs::path dir = fs::path(file).parent_path();
+         !dir.empty() && fs::is_empty(dir, ec) && !ec;
+         dir = dir.parent_path()) {
+        fs::remove(dir, ec);
+    }
+}
+
 bool Init::isLegal(const vector<string> &args) const {
     if (fs::exists(".gitlet")) {
         throw runtime_error("A Gitlet version-control system, already exists in "
                             "the current directory");
     }
-    return args.size() == 2;
+    return args.size() == 2 || (args.size() == 4 && args[2] == "--hash");
 }
 
 void Init::exec(Gitlet &git, const vector<string> &args) {
+    // the hash of ids is chosen once, before the first object
+    string hash = args.size() == 4 ? args[3] : "sha1";
+    utils::setHashAlgorithm(utils::hashAlgorithm(hash));
     string logMessage = "initial commit";
     string branchName = "master";
     Commit initial(logMessage);
     git.insertBranchCommit(branchName, initial.getID());
     git.setCurBranch(branchName);
     git.setHead(initial.getID());
-    string timestamp = initial.getTimeStamp();
-    git.setID(utils::sha1(
+    string timestamp(initial.getTimeStamp());
+    git.setID(utils::hash(
         {logMessage, timestamp, branchName}));  // won't change any more
     fs::create_directory(".gitlet");
     fs::create_directory(".gitlet/info");
     fs::create_directory(".gitlet/commit");
+    fs::create_directory(".gitlet/tree");
     fs::create_directory(".gitlet/blob");
-    utils::save(initial, Commit::getDir() / initial.getID());
+    if (hash != "sha1") {
+        utils::writeFile(utils::Config::getFile(), "hash = " + hash + "\n");
+    }
+    initial.save();
 }
 
 bool Add::isLegal(const vector<string> &args) const {
     if (!fs::exists(".gitlet")) {
         throw runtime_error("Not in an initialized Gitlet directory");
-    } else if (args.size() != 3) {
+    } else if (args.size() < 3) {
         return false;
-    } else if (!fs::exists(args[2])) {
-        throw runtime_error("File does not exist.");
-    } else {
-        return true;
     }
+    for (auto iter = args.begin() + 2; iter != args.end(); ++iter) {
+        if (!fs::exists(*iter)) {
+            throw runtime_error("File does not exist.");
+        }
+        workingPath(*iter);
+    }
+    return true;
+}
+
+// expand the given paths into the regular files to add, a directory stands
+// for the regular files below it
+vector<string> Add::listFiles(const vector<string> &args) {
+    vector<string> files;
+    for (auto iter = args.begin() + 2; iter != args.end(); ++iter) {
+        string p = workingPath(*iter);
+        if (fs::is_directory(p)) {
+            listWorkingFiles(p, files);
+        } else {
+            files.push_back(p);
+        }
+    }
+    sort(files.begin(), files.end());
+    files.erase(unique(files.begin(), files.end()), files.end());
+    return files;
 }
 
 void Add::exec(Gitlet &git, const vector<string> &args) {
-    string file = args[2];
-    string content = utils::readFile(file);
-    Blob blob(content);
-    string id = blob.getID();
-    // if marked removed, remove that mark
-    git.eraseRemovedBlob(file);
-
-    // if identical to the current commit, don't add and
-    // remove the staged blob
+    vector<string> files = listFiles(args);
     string head = git.getHead();
-    Commit cur;
-    utils::load(cur, Commit::getDir() / head);
-    if (cur.blobExists(id)) {
-        git.eraseStagedBlob(file);
-        return;
-    }
-    // remove previous staged file
-    string oldID = git.getStagedBlobID(file);
-    if (!oldID.empty()) {
-        fs::remove(Blob::getDir() / oldID);
+    auto cur = Commit::load(head);
+    // hash and save the files on all cores, new blobs are stored as deltas
+    // against the version of the same file in the current commit
+    vector<string> ids(files.size());
+    utils::parallelFor(files.size(), [&](size_t i) {
+        bool created = false;
+        ids[i] = Blob::saveFile(files[i], &created);
+        string base(cur->getBlobID(files[i]));
+        if (created && !base.empty()) {
+            Blob::deltify(ids[i], base);
+        }
+    });
+    // then update the staging area once; a blob no longer staged is left for
+    // gc, an older commit may still have it or a delta may be based on it
+    for (size_t i = 0; i != files.size(); ++i) {
+        const string &file = files[i];
+        const string &id = ids[i];
+        // if marked removed, remove that mark
+        git.eraseRemovedBlob(file);
+        // if identical to the current commit, don't add and
+        // remove the staged blob
+        if (cur->getBlobID(file) == id) {
+            git.eraseStagedBlob(file);
+            continue;
+        }
+        // staged file is already saved, may overwrite previous entry
+        git.insertStagedBlob(file, id);
     }
-    // save staged file, may overwrite previous entry
-    git.insertStagedBlob(file, id);
-    utils::save(blob, Blob::getDir() / id);
 }
 
 bool CommitCmd::isLegal(const vector<string> &args) const {
@@ -113,26 +216,39 @@ void CommitCmd::exec(Gitlet &git, const vector<string> &args) {
         throw runtime_error("No changes added to the commit");
     }
     string head = git.getHead();
-    Commit cur;
-    utils::load(cur, Commit::getDir() / head);
+    auto cur = Commit::load(head);
     unordered_map<string, string> stage = git.getStagedBlob();
-    unordered_map<string, string> blobs = cur.getCommitBlob();
-    unordered_map<string, string> commitBlob;
-    for (const auto &i : blobs) {
-        if (!git.isRemoved(i.first)) {
-            commitBlob.insert(i);
-        }
+    // only the trees along the staged and removed paths are saved again, the
+    // others are shared with the current commit
+    std::map<string, string> changes(stage.begin(), stage.end());
+    unordered_set<string> removed = git.getRemovedBlob();
+    for (const auto &file : removed) {
+        changes.emplace(file, string());
     }
-    for (const auto &i : stage) {
-        commitBlob[i.first] = i.second;
-    }
-    Commit newCommit(args[2], commitBlob, head);
+    Commit newCommit(args[2], Tree::update(Tree::of(*cur), changes), head);
     string newHead = newCommit.getID();
     string branch = git.getCurBranch();
     git.setHead(newHead);
     git.insertBranchCommit(branch, newHead);
+    // keep the stat cache warm for the files of the new commit
+    Index index;
+    for (const auto &file : removed) {
+        index.erase(file);
+    }
+    vector<string> files;
+    for (const auto &i : stage) {
+        if (fs::exists(i.first)) {
+            files.push_back(i.first);
+        }
+    }
+    index.getBlobIDs(files);
+    index.save();
     git.clearStagedBlob();
-    utils::save(newCommit, Commit::getDir() / newHead);
+    git.clearRemovedBlob();
+    newCommit.save();
+    CommitGraph graph;
+    graph.add(newCommit);
+    graph.save();
 }
 
 bool Rm::isLegal(const vector<string> &args) const {
@@ -148,30 +264,35 @@ bool Rm::isLegal(const vector<string> &args) const {
 }
 
 void Rm::exec(Gitlet &git, const vector<string> &args) {
-    string content = utils::readFile(args[2]);
-    string expectedBlobID = utils::sha1({content});
-    string actualBlobID = git.getStagedBlobID(args[2]);
+    string file = workingPath(args[2]);
+    string expectedBlobID = utils::hashFile(file);
+    string actualBlobID = git.getStagedBlobID(file);
     string head = git.getHead();
-    Commit cur;
-    utils::load(cur, Commit::getDir() / head);
-    if (actualBlobID.empty() && !cur.blobExists(expectedBlobID)) {
+    auto cur = Commit::load(head);
+    if (actualBlobID.empty() && !cur->blobExists(expectedBlobID)) {
         throw runtime_error("No reason to remove the file");
     } else {
         if (!actualBlobID.empty()) {
-            git.eraseStagedBlob(args[2]);
+            git.eraseStagedBlob(file);
         }
-        if (cur.blobExists(expectedBlobID)) {
-            git.insertRemovedBlob(args[2]);
-            fs::remove(args[2]);
+        if (cur->blobExists(expectedBlobID)) {
+            git.insertRemovedBlob(file);
+            removeWorkingFile(file);
         }
     }
 }
 
-void AbstractLog::printLog(const string &id) {
-    Commit cur;
-    utils::load(cur, Commit::getDir() / id);
-    string par1 = cur.getParent1();
-    string par2 = cur.getParent2();
+void AbstractLog::printLog(const string &id, Commit &c) {
+    // a commit another command cached is used as it is, others are read into
+    // c rather than cached
+    auto cached = Commit::cached(id);
+    if (!cached) {
+        Commit::read(id, c);
+    }
+    const Commit &cur = cached ? *cached : c;
+    std::string_view par1 = cur.getParent1();
+    std::string_view par2 = cur.getParent2();
+    trace::Scope scope("output");
     cout << "===" << endl;
     cout << "commit " << id << endl;
     if (!par2.empty()) {
@@ -183,6 +304,15 @@ void AbstractLog::printLog(const string &id) {
     cout << endl;
 }
 
+// the commits the branches point to
+static vector<string> branchTips(const Gitlet &git) {
+    vector<string> tips;
+    for (const auto &i : git.getBranchCommit()) {
+        tips.push_back(i.second);
+    }
+    return tips;
+}
+
 bool Log::isLegal(const vector<string> &args) const {
     if (!fs::exists(".gitlet")) {
         throw runtime_error("Not in an initialized Gitlet directory");
@@ -191,19 +321,18 @@ bool Log::isLegal(const vector<string> &args) const {
 }
 
 void Log::exec(Gitlet &git, const vector<string> &args) {
-    string id = git.getHead();
-    Commit cur;
-    while (!id.empty()) {
-        printLog(id);
-        utils::load(cur, Commit::getDir() / id);
-        id = cur.getParent1();
+    // one commit and id are reused along the log, nothing is allocated per
+    // commit
+    CommitGraph graph;
+    Commit c;
+    string id;
+    uint32_t pos = graph.lookup(git.getHead());
+    for (; pos != CommitGraph::none; pos = graph.getParent1(pos)) {
+        graph.getID(pos, id);
+        printLog(id, c);
     }
 }
 
-void GlobalLog::addCommits(const string &id) { commits.insert(id); }
-
-bool GlobalLog::isVisited(const string &id) { return commits.count(id); }
-
 bool GlobalLog::isLegal(const vector<string> &args) const {
     if (!fs::exists(".gitlet")) {
         throw runtime_error("Not in an initialized Gitlet directory");
@@ -211,22 +340,22 @@ bool GlobalLog::isLegal(const vector<string> &args) const {
     return args.size() == 2;
 }
 
+// every commit reachable from the branches, the newest first
 void GlobalLog::exec(Gitlet &git, const vector<string> &args) {
-    string id;
-    unordered_map<string, string> branchCommit = git.getBranchCommit();
-    Commit cur;
-    for (const auto &i : branchCommit) {
-        id = i.second;
-        while (!id.empty()) {
-            if (!isVisited(id)) {
-                addCommits(id);
-                printLog(id);
-                utils::load(cur, Commit::getDir() / id);
-                id = cur.getParent1();
-            } else {
-                break;
-            }
-        }
+    bitmap::Bitmaps bitmaps;
+    CommitGraph graph;
+    // commits made in the same second go children first
+    vector<std::tuple<std::int64_t, uint32_t, string>> commits;
+    bitmaps.commits(branchTips(git))
+        .forEach(bitmap::commitKind, [&](const string &id) {
+            uint32_t pos = graph.lookup(id);
+            commits.emplace_back(graph.getTime(pos), graph.getGeneration(pos),
+                                 id);
+        });
+    sort(commits.rbegin(), commits.rend());
+    Commit c;
+    for (const auto &i : commits) {
+        printLog(std::get<2>(i), c);
     }
 }
 
@@ -253,11 +382,6 @@ bool Status::isLegal(const std::vector<std::string> &args) const {
     return args.size() == 2;
 }
 
-Commit::Commit(const string &log) : log(log) {
-    timestamp = getEpochTime();
-    id = utils::sha1({log, timestamp, parent1, parent2});
-}
-
 void Status::exec(Gitlet &git, const std::vector<std::string> &args) {
     // print branches
     unordered_map<string, string> branchCommit = git.getBranchCommit();
@@ -293,33 +417,37 @@ void Status::exec(Gitlet &git, const std::vector<std::string> &args) {
     string deleted = " (deleted)";
     string modified = " (modified)";
     vector<string> modifiedNotStaged;
+    Index index;  // only files whose stat data changed are rehashed
+    // the files left are hashed together, with the id each should have
+    vector<string> files, expected;
     // staged but modified or deleted
     for (const auto &i : stagedBlob) {
         if (!fs::exists(i.first)) {  // deleted
             modifiedNotStaged.push_back(i.first + deleted);
         } else {
-            Blob blob(utils::readFile(i.first));
-            if (blob.getID() != i.second) {
-                modifiedNotStaged.push_back(i.first + modified);
-            }
+            files.push_back(i.first);
+            expected.push_back(i.second);
         }
     }
     // tracked but modified & not staged  or deleted
-    Commit cur;
     string head = git.getHead();
-    utils::load(cur, Commit::getDir() / head);
-    unordered_map<string, string> commitBlob = cur.getCommitBlob();
-    for (const auto &i : commitBlob) {
-        if (!fs::exists(i.first)) {  // deleted
-            modifiedNotStaged.push_back(i.first + deleted);
-        } else {
-            Blob blob(utils::readFile(i.first));
-            if (blob.getID() != commitBlob[i.first] &&
-                stagedBlob.find(i.first) == stagedBlob.end()) {
-                modifiedNotStaged.push_back(i.first + modified);
-            }
+    auto cur = Commit::load(head);
+    for (const auto &i : cur->getFiles()) {
+        string file(i.first);
+        if (!fs::exists(file)) {  // deleted
+            modifiedNotStaged.push_back(file + deleted);
+        } else if (stagedBlob.find(file) == stagedBlob.end()) {
+            files.push_back(file);
+            expected.emplace_back(i.second);
         }
     }
+    vector<string> ids = index.getBlobIDs(files);
+    for (size_t i = 0; i != files.size(); ++i) {
+        if (ids[i] != expected[i]) {
+            modifiedNotStaged.push_back(files[i] + modified);
+        }
+    }
+    index.save();
     sort(modifiedNotStaged.begin(), modifiedNotStaged.end());
     for (const auto &i : modifiedNotStaged) {
         cout << i << endl;
@@ -327,14 +455,12 @@ void Status::exec(Gitlet &git, const std::vector<std::string> &args) {
     cout << endl;
     // print untracked files
     cout << "=== Untracked Files ===" << endl;
-    vector<string> untracked;
-    for (auto &iter : fs::directory_iterator(".")) {
-        if (fs::is_regular_file(iter.path())) {
-            string file = iter.path().filename();
-            if (stagedBlob.find(file) == stagedBlob.end() &&
-                commitBlob.find(file) == commitBlob.end()) {
-                untracked.push_back(file);
-            }
+    vector<string> working, untracked;
+    listWorkingFiles(".", working);
+    for (const auto &file : working) {
+        if (stagedBlob.find(file) == stagedBlob.end() &&
+            cur->getBlobID(file).empty()) {
+            untracked.push_back(file);
         }
     }
     sort(untracked.begin(), untracked.end());
@@ -361,9 +487,10 @@ void Checkout::exec(Gitlet &git, const vector<string> &args) {
     string id;
     if (sz == 3) {  // with branch name
         // check untracked files
-        for (auto &iter : fs::directory_iterator(".")) {
-            string file = iter.path().filename();
-            if (fs::is_regular_file(file) && isUntracked(git, file)) {
+        vector<string> working;
+        listWorkingFiles(".", working);
+        for (const auto &file : working) {
+            if (isUntracked(git, file)) {
                 throw runtime_error("Threr is an untracked file in the way; "
                                     "delete it or add it first");
             }
@@ -377,91 +504,146 @@ void Checkout::exec(Gitlet &git, const vector<string> &args) {
         if (id.empty()) {
             throw runtime_error("No such branch exists");
         }
+        unordered_map<string, string> staged = git.getStagedBlob();
         git.clearStagedBlob();         // clear the staging area
         git.setCurBranch(branchName);  // update current branch
         if (id == git.getHead()) {     // if it's head commit, then no need to
                                        // change files
             return;
         }
+        takeCommitFiles(git.getHead(), id);
+        // files only staged go unless the given commit has them
+        auto to = Commit::load(id);
+        for (const auto &i : staged) {
+            if (to->getBlobID(i.first).empty()) {
+                removeWorkingFile(i.first);
+            }
+        }
         git.setHead(id);  // update head ref
-        takeCommitFiles(id);
     } else {  // with commit id
         // check whether the given file is untracked
-        string file = args[sz - 1];
+        string file = workingPath(args[sz - 1]);
         if (fs::is_regular_file(file) && isUntracked(git, file)) {
             throw runtime_error("Threr is an untracked file in the way; delete "
                                 "it or add it first");
         }
-        id = (sz == 4 ? git.getHead() : args[2]);
-        if (id.size() < 40) {
-            id = getTotalID(id);
-        }
+        id = (sz == 4 ? git.getHead() : git.resolveCommitID(args[2]));
         takeCommitFile(id, file);
     }
 }
 
-// given a shortened commit id, return a total id
-string Checkout::getTotalID(string id) {
-    fs::path dir = Commit::getDir();
-    int sz = id.size();
-    string file;
-    for (auto &iter : fs::directory_iterator(dir)) {
-        file = iter.path().filename();
-        if (file.substr(0, sz) == id) {
-            return file;
+string Gitlet::resolveCommitID(const string &prefix) const {
+    // every commit is reachable from a branch, so once the branches are in
+    // the commit-graph, it knows all commits
+    CommitGraph graph;
+    for (const auto &i : branchCommit) {
+        graph.lookup(i.second);
+    }
+    vector<string> ids = graph.matchPrefix(prefix);
+    // gc removes commits no branch reaches any more, but their records stay
+    // in the graph, which is never shrunk
+    ids.erase(std::remove_if(ids.begin(), ids.end(),
+                             [](const string &id) {
+                                 return !utils::objectExists(Commit::getDir(),
+                                                             id);
+                             }),
+              ids.end());
+    if (ids.empty()) {
+        throw runtime_error("No commit with that id exists.");
+    } else if (ids.size() > 1) {
+        string msg = "The commit id " + prefix + " is ambiguous, it matches";
+        for (const auto &id : ids) {
+            msg += " " + id;
         }
+        throw runtime_error(msg);
     }
-    throw runtime_error("No commit with that id exists.");
+    return ids.front();
 }
 
 // check whether the given regular file is untracked
 bool Checkout::isUntracked(Gitlet &git, string file) {
-    Commit cur;
-    string head = git.getHead();
-    utils::load(cur, Commit::getDir() / head);
-    unordered_map<string, string> stagedBlob = git.getStagedBlob();
-    unordered_map<string, string> commitBlob = cur.getCommitBlob();
-    if (stagedBlob.find(file) == stagedBlob.end() &&
-        commitBlob.find(file) == commitBlob.end()) {
-        return true;
-    }
-    return false;
+    auto cur = Commit::load(git.getHead());
+    return git.getStagedBlobID(file).empty() && cur->getBlobID(file).empty();
 }
 
-// given commit id, clear the current files and take the version of files that
-// exist in the given commit id
-void Checkout::takeCommitFiles(string id) {
-    Commit c;
-    utils::load(c, Commit::getDir() / id);
-    unordered_map<string, string> commitBlob = c.getCommitBlob();
-    Blob blob;
-    // clear files in current working directory
-    for (auto &iter : fs::directory_iterator(".")) {
-        if (fs::is_regular_file(iter.path())) {
-            fs::remove(iter.path());
+// given the current commit head and commit id, make the working files those
+// of commit id: files that differ between the trees of the commits are
+// removed or written, found without reading the subtrees they share; an
+// unchanged file is only written if the working copy was modified, which the
+// index tells from its stat data
+void Checkout::takeCommitFiles(const string &head, const string &id) {
+    auto from = Commit::load(head);
+    auto to = Commit::load(id);
+    Index index;
+    vector<string> removed;
+    vector<std::pair<string, string>> writes;
+    Tree::diff(Tree::of(*from), Tree::of(*to),
+               [&](const string &file, std::string_view,
+                   std::string_view blobID) {
+                   if (blobID.empty()) {
+                       removed.push_back(file);
+                   } else {
+                       writes.emplace_back(file, blobID);
+                   }
+               });
+    // both are in path order
+    size_t changed = writes.size(), next = 0;
+    vector<std::pair<string, string>> unchanged;  // hashed together
+    for (const auto &i : to->getFiles()) {
+        while (next != changed && writes[next].first < i.first) {
+            ++next;
+        }
+        if (next != changed && writes[next].first == i.first) {
+            continue;
         }
+        string file(i.first);
+        if (!fs::is_regular_file(file)) {
+            writes.emplace_back(file, i.second);
+        } else {
+            unchanged.emplace_back(file, i.second);
+        }
+    }
+    vector<string> files;
+    for (const auto &i : unchanged) {
+        files.push_back(i.first);
+    }
+    vector<string> ids = index.getBlobIDs(files);
+    for (size_t i = 0; i != unchanged.size(); ++i) {
+        if (ids[i] != unchanged[i].second) {
+            writes.push_back(std::move(unchanged[i]));
+        }
+    }
+    // removed first, a directory may become a file
+    for (const auto &file : removed) {
+        removeWorkingFile(file);
+        index.erase(file);
     }
-    // take the files in the given commit
-    for (const auto &i : commitBlob) {
-        utils::load(blob, Blob::getDir() / i.second);
-        utils::writeFile(i.first, blob.getContent());
+    for (const auto &i : writes) {
+        makeParentDirs(i.first);
     }
+    utils::parallelFor(writes.size(), [&](size_t i) {
+        Blob::writeFile(writes[i].second, writes[i].first);
+    });
+    for (const auto &i : writes) {
+        index.update(i.first, i.second);
+    }
+    index.save();
 }
 
 void Checkout::takeCommitFile(string id, string file) {
-    fs::path cpath = Commit::getDir() / id;
-    if (!fs::exists(cpath)) {
+    if (!utils::objectExists(Commit::getDir(), id)) {
         throw runtime_error("No commit with that id exists.");
     }
-    Commit c;
-    utils::load(c, cpath);
-    Blob blob;
-    string blobID = c.getBlobID(file);
+    auto c = Commit::load(id);
+    string blobID(c->getBlobID(file));
     if (blobID.empty()) {
         throw runtime_error("File does not exist in that commit.");
     }
-    utils::load(blob, Blob::getDir() / blobID);
-    utils::writeFile(file, blob.getContent());
+    makeParentDirs(file);
+    Blob::writeFile(blobID, file);
+    Index index;
+    index.update(file, blobID);
+    index.save();
 }
 
 bool Branch::isLegal(const vector<string> &args) const {
@@ -478,17 +660,489 @@ void Branch::exec(Gitlet &git, const vector<string> &args) {
     git.insertBranchCommit(args[2], git.getHead());
 }
 
+static const char commitMagic[] = "GCMT";
+static const uint32_t commitVersion = 1;
+static const char treeMagic[] = "GTRE";
+static const uint32_t treeVersion = 1;
+static const size_t headerSize = 12;  // magic, version, count
+
+// commits as boost serialized them before the flat format
+namespace {
+class LegacyCommit : public GitletObj {
+  public:
+    string log;
+    string timestamp;
+    unordered_map<string, string> commitBlob;
+    string parent1;
+    string parent2;
+
+  private:
+    friend class boost::serialization::access;
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+        ar &boost::serialization::base_object<GitletObj>(*this);
+        ar &log &timestamp &commitBlob;
+        ar &parent1 &parent2;
+    }
+};
+}  // namespace
+
+// flat bytes of a commit or tree: the header, the offsets of the fields and
+// of their end, then the fields
+static string flatten(const char *magic, uint32_t version, uint32_t count,
+                      const vector<std::string_view> &fields) {
+    string out(magic, 4);
+    utils::putU32(out, version);
+    utils::putU32(out, count);
+    uint64_t offset = headerSize + 4 * (fields.size() + 1);
+    for (const auto &f : fields) {
+        utils::putU32(out, offset);
+        offset += f.size();
+    }
+    if (offset > UINT32_MAX) {
+        throw runtime_error(magic == string(treeMagic) ? "tree too large"
+                                                       : "commit too large");
+    }
+    utils::putU32(out, offset);
+    out.reserve(offset);
+    for (const auto &f : fields) {
+        out.append(f);
+    }
+    return out;
+}
+
+// flat bytes of the file list of a commit, the name and blob id of each
+// file sorted by name
+static string flatten(const vector<std::pair<string, string>> &files) {
+    vector<std::string_view> fields;
+    for (const auto &i : files) {
+        fields.push_back(i.first);
+        fields.push_back(i.second);
+    }
+    return flatten(commitMagic, commitVersion, files.size(), fields);
+}
+
+// check that the offsets of flat bytes with the given number of fields
+// follow each other up to the end, if they don't, throw a runtime_error
+static void checkOffsets(std::string_view data, uint64_t fields,
+                         const char *what) {
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    uint64_t offsets = fields + 1;
+    if ((data.size() - headerSize) / 4 < offsets) {
+        throw runtime_error(string("corrupt ") + what);
+    }
+    // the strings follow the offsets, in order, up to the end
+    uint64_t prev = headerSize + 4 * offsets;
+    for (uint64_t i = 0; i != offsets; ++i) {
+        uint32_t offset = utils::getU32(p + headerSize + 4 * i);
+        if ((i == 0 && offset != prev) || offset < prev) {
+            throw runtime_error(string("corrupt ") + what);
+        }
+        prev = offset;
+    }
+    if (prev != data.size()) {
+        throw runtime_error(string("corrupt ") + what);
+    }
+}
+
+// field i of flat bytes
+static std::string_view flatField(std::string_view data, size_t i) {
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data()) +
+                    headerSize + 4 * i;
+    uint32_t from = utils::getU32(p);
+    return data.substr(from, utils::getU32(p + 4) - from);
+}
+
+static uint32_t flatCount(std::string_view data) {
+    return utils::getU32(reinterpret_cast<const unsigned char *>(data.data()) +
+                         8);
+}
+
+const std::filesystem::path Tree::dir = ".gitlet/tree";
+
+size_t Tree::size() const { return data.empty() ? 0 : flatCount(data); }
+
+Tree::Entry Tree::getEntry(size_t i) const {
+    return {flatField(data, 2 * i), flatField(data, 2 * i + 1)};
+}
+
+std::string_view Tree::find(std::string_view name) const {
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (flatField(data, 2 * mid) < name) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo != size() && flatField(data, 2 * lo) == name) {
+        return flatField(data, 2 * lo + 1);
+    }
+    return {};
+}
+
+// trees never change once saved, so every command shares the loaded ones
+static utils::LRUCache<string, std::shared_ptr<const Tree>> treeCache(1024);
+
+std::shared_ptr<const Tree> Tree::load(const string &id) {
+    static const auto empty = std::make_shared<const Tree>();
+    if (id.empty()) {
+        return empty;
+    }
+    std::shared_ptr<const Tree> t;
+    if (!treeCache.get(id, t)) {
+        auto loaded = std::make_shared<Tree>();
+        std::string_view stored =
+            utils::loadObjectBytes(dir, id, loaded->mapped, loaded->buffer);
+        if (stored.data() != loaded->buffer.data() &&
+            stored.data() !=
+                reinterpret_cast<const char *>(loaded->mapped.data())) {
+            // a view into a pack, which is unmapped once the packs change
+            loaded->buffer.assign(stored);
+            stored = loaded->buffer;
+        }
+        const auto *p = reinterpret_cast<const unsigned char *>(stored.data());
+        if (stored.size() < headerSize || stored.substr(0, 4) != treeMagic) {
+            throw runtime_error("corrupt tree");
+        } else if (utils::getU32(p + 4) != treeVersion) {
+            throw runtime_error("unsupported tree version");
+        }
+        checkOffsets(stored, 2 * uint64_t(flatCount(stored)), "tree");
+        loaded->data = stored;
+        t = loaded;
+        treeCache.put(id, t);
+    }
+    return t;
+}
+
+string Tree::update(const string &root,
+                    const std::map<string, string> &changes) {
+    return update(root, changes.begin(), changes.end(), 0);
+}
+
+// changes from begin to end are the sorted paths below the directory of
+// tree id, which start prefix characters in
+string Tree::update(const string &id, Changes begin, Changes end,
+                    size_t prefix) {
+    auto tree = load(id);
+    std::map<string, string> entries;
+    for (size_t i = 0, n = tree->size(); i != n; ++i) {
+        Entry e = tree->getEntry(i);
+        entries.emplace(e.first, e.second);
+    }
+    while (begin != end) {
+        std::string_view rest = std::string_view(begin->first).substr(prefix);
+        size_t slash = rest.find('/');
+        std::string_view name = rest.substr(0, slash);
+        if (name.empty() || name == "." || name == "..") {
+            throw runtime_error("bad path " + begin->first);
+        }
+        if (slash == std::string_view::npos) {  // a file of this directory
+            if (begin->second.empty()) {
+                entries.erase(string(name));
+            } else {
+                entries[string(name)] = begin->second;
+            }
+            ++begin;
+            continue;
+        }
+        // the paths below a subdirectory follow each other
+        string sub(rest.substr(0, slash + 1));
+        Changes last = begin;
+        while (last != end && last->first.size() > prefix + sub.size() &&
+               last->first.compare(prefix, sub.size(), sub) == 0) {
+            ++last;
+        }
+        auto iter = entries.find(sub);
+        string subID = update(iter == entries.end() ? string() : iter->second,
+                              begin, last, prefix + sub.size());
+        if (subID.empty()) {
+            entries.erase(sub);
+        } else {
+            entries[sub] = subID;
+        }
+        begin = last;
+    }
+    if (entries.empty()) {
+        return {};
+    }
+    vector<std::string_view> fields;
+    for (const auto &i : entries) {
+        fields.push_back(i.first);
+        fields.push_back(i.second);
+    }
+    string bytes = flatten(treeMagic, treeVersion, entries.size(), fields);
+    string treeID = utils::hash({bytes});
+    if (!utils::objectExists(dir, treeID)) {
+        fs::create_directory(dir);  // missing in older repositories
+        utils::saveBytes(bytes, utils::newObjectPath(dir, treeID));
+    }
+    return treeID;
+}
+
+string Tree::of(const Commit &c) {
+    if (!c.getTree().empty() || c.getFiles().size() == 0) {
+        return string(c.getTree());
+    }
+    std::map<string, string> files;
+    for (const auto &i : c.getFiles()) {
+        files.emplace(i.first, i.second);
+    }
+    return update({}, files);
+}
+
+void Tree::diff(const string &from, const string &to, const DiffFunc &f) {
+    diff(from, to, {}, f);
+}
+
+void Tree::diff(const string &from, const string &to, const string &prefix,
+                const DiffFunc &f) {
+    if (from == to) {
+        return;
+    }
+    auto a = load(from), b = load(to);
+    size_t i = 0, j = 0;
+    while (i != a->size() || j != b->size()) {
+        Entry x = i != a->size() ? a->getEntry(i) : Entry();
+        Entry y = j != b->size() ? b->getEntry(j) : Entry();
+        std::string_view name;
+        if (j == b->size() || (i != a->size() && x.first < y.first)) {
+            name = x.first;
+            y = Entry();
+            ++i;
+        } else if (i == a->size() || y.first < x.first) {
+            name = y.first;
+            x = Entry();
+            ++j;
+        } else {
+            name = x.first;
+            ++i;
+            ++j;
+        }
+        if (x.second == y.second) {
+            continue;
+        } else if (name.back() == '/') {
+            diff(string(x.second), string(y.second), prefix + string(name),
+                 f);
+        } else {
+            f(prefix + string(name), x.second, y.second);
+        }
+    }
+}
+
+void Tree::walk(const string &id, const WalkFunc &f) { walk(id, {}, f); }
+
+void Tree::walk(const string &id, const string &prefix, const WalkFunc &f) {
+    auto tree = load(id);
+    for (size_t i = 0, n = tree->size(); i != n; ++i) {
+        Entry e = tree->getEntry(i);
+        if (e.first.back() == '/') {
+            walk(string(e.second), prefix + string(e.first), f);
+        } else {
+            f(prefix + string(e.first), e.second);
+        }
+    }
+}
+
+Commit::Commit(const string &log) {
+    string timestamp = getEpochTime();
+    id = utils::hash({log, timestamp, "", ""});
+    buffer = flatten(commitMagic, commitVersion, 0,
+                     {log, timestamp, "", "", ""});
+    assign(buffer);
+}
+
 Commit::Commit(const string &log,
                const unordered_map<string, string> &commitBlob,
-               const string &parent1,
-               const string &parent2)
-    : log(log), commitBlob(commitBlob), parent1(parent1), parent2(parent2) {
-    string blobRef;
-    for (const auto &i : commitBlob) {
-        blobRef.append(i.second);
+               const string &parent1, const string &parent2)
+    : Commit(log,
+             Tree::update({}, std::map<string, string>(commitBlob.begin(),
+                                                       commitBlob.end())),
+             parent1, parent2) {}
+
+Commit::Commit(const string &log, const string &tree, const string &parent1,
+               const string &parent2) {
+    string timestamp = getCurrentTime();
+    id = utils::hash({log, timestamp, tree, parent1, parent2});
+    buffer = flatten(commitMagic, commitVersion, 0,
+                     {log, timestamp, parent1, parent2, tree});
+    assign(buffer);
+}
+
+void Commit::parse() {
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    if (data.size() < headerSize || data.substr(0, 4) != commitMagic) {
+        throw runtime_error("corrupt commit");
+    } else if (utils::getU32(p + 4) != commitVersion) {
+        throw runtime_error("unsupported commit version");
+    } else if (utils::getU32(p + 8) != 0) {
+        throw runtime_error("corrupt commit");
+    }
+    checkOffsets(data, treeField + 1, "commit");
+}
+
+void Commit::assign(std::string_view stored) {
+    legacy = stored.substr(0, 4) != commitMagic;
+    if (legacy) {
+        // no tree, the files are listed right away
+        LegacyCommit old;
+        utils::MemoryBuf buf(stored);
+        boost::archive::binary_iarchive ia(buf);
+        ia >> old;
+        vector<std::pair<string, string>> files(old.commitBlob.begin(),
+                                                old.commitBlob.end());
+        sort(files.begin(), files.end());
+        listing = flatten(files);
+        buffer = flatten(commitMagic, commitVersion, 0,
+                         {old.log, old.timestamp, old.parent1, old.parent2,
+                          ""});
+        stored = buffer;
+    } else if (stored.data() != buffer.data() &&
+               stored.data() !=
+                   reinterpret_cast<const char *>(mapped.data())) {
+        // a view into a pack, which is unmapped once the packs change
+        buffer.assign(stored);
+        stored = buffer;
+    }
+    data = stored;
+    indexed = false;
+    listed = false;
+    parse();
+}
+
+std::string_view Commit::field(size_t i) const {
+    if (data.empty()) {
+        return {};
+    }
+    return flatField(data, i);
+}
+
+std::string_view Commit::getTree() const { return field(treeField); }
+
+void Commit::list() const {
+    if (listed.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(indexMutex);
+    if (listed.load(std::memory_order_relaxed)) {
+        return;
     }
-    timestamp = getCurrentTime();
-    id = utils::sha1({log, timestamp, blobRef, parent1, parent2});
+    if (!legacy) {
+        vector<std::pair<string, string>> entries;
+        Tree::walk(string(getTree()),
+                   [&](const string &path, std::string_view blobID) {
+                       entries.emplace_back(path, blobID);
+                   });
+        listing = flatten(entries);
+    }
+    listed.store(true, std::memory_order_release);
+}
+
+size_t Commit::fileCount() const {
+    list();
+    return flatCount(listing);
+}
+
+Commit::File Commit::getFile(size_t i) const {
+    return {flatField(listing, 2 * i), flatField(listing, 2 * i + 1)};
+}
+
+std::string_view Commit::getBlobID(std::string_view file) const {
+    // binary search of the sorted names
+    size_t lo = 0, hi = fileCount();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (flatField(listing, 2 * mid) < file) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo != fileCount() && flatField(listing, 2 * lo) == file) {
+        return flatField(listing, 2 * lo + 1);
+    }
+    return {};
+}
+
+bool Commit::blobExists(std::string_view id) const {
+    size_t n = fileCount();
+    std::lock_guard<std::mutex> lock(indexMutex);
+    if (!indexed) {
+        blobIndex.clear();
+        for (size_t i = 0; i != n; ++i) {
+            blobIndex.push_back(getFile(i).second);
+        }
+        sort(blobIndex.begin(), blobIndex.end());
+        indexed = true;
+    }
+    return std::binary_search(blobIndex.begin(), blobIndex.end(), id);
+}
+
+void Commit::save() const {
+    utils::saveBytes(data, utils::newObjectPath(dir, id));
+}
+
+// commits never change once saved, so every command shares the loaded ones
+static utils::LRUCache<string, std::shared_ptr<const Commit>> commitCache(256);
+
+std::shared_ptr<const Commit> Commit::load(const string &id) {
+    std::shared_ptr<const Commit> c;
+    if (!commitCache.get(id, c)) {
+        auto loaded = std::make_shared<Commit>();
+        read(id, *loaded);
+        c = loaded;
+        commitCache.put(id, c);
+    }
+    return c;
+}
+
+std::shared_ptr<const Commit> Commit::cached(const string &id) {
+    std::shared_ptr<const Commit> c;
+    commitCache.get(id, c);
+    return c;
+}
+
+void Commit::read(const string &id, Commit &c) {
+    c.id = id;
+    // a loose object is mapped through a path built without fs::path, which
+    // allocates; anything else, a flat or packed object or one pending in the
+    // transaction, goes through loadObjectBytes()
+    char file[256];
+    std::string_view stored;
+    if (id.size() == 40 &&
+        snprintf(file, sizeof(file), "%s/%.2s/%s", dir.c_str(), id.c_str(),
+                 id.c_str() + 2) < int(sizeof(file)) &&
+        c.mapped.map(file)) {
+        stored = std::string_view(
+            reinterpret_cast<const char *>(c.mapped.data()), c.mapped.size());
+        trace::count(trace::objectsRead);
+        if (codec::decode(stored, c.buffer)) {
+            stored = c.buffer;
+        }
+    } else {
+        c.mapped = utils::MappedFile();
+        stored = utils::loadObjectBytes(dir, id, c.mapped, c.buffer);
+    }
+    c.assign(stored);
+}
+
+utils::CacheStats Commit::getCacheStats() { return commitCache.getStats(); }
+
+std::int64_t Commit::getTime() const {
+    std::string_view timestamp = getTimeStamp();
+    char s[64];
+    if (timestamp.size() >= sizeof(s)) {
+        return 0;
+    }
+    memcpy(s, timestamp.data(), timestamp.size());
+    s[timestamp.size()] = '\0';
+    std::tm tm = {};
+    if (!strptime(s, "%a %b %d %H:%M:%S %Y", &tm)) {
+        return 0;
+    }
+    tm.tm_isdst = -1;  // ctime() printed local time
+    return std::mktime(&tm);
 }
 
 string Commit::getCurrentTime() const {
@@ -503,4 +1157,547 @@ string Commit::getEpochTime() const {
     return string(ctime(&epoch_time));
 }
 
-Blob::Blob(string content) : content(content) { id = utils::sha1({content}); }
+Blob::Blob(string content) : content(std::move(content)) {
+    id = utils::hash({this->content});
+}
+
+string Blob::saveFile(const fs::path &file, bool *created) {
+    // a saved blob is the archive header, the id and the content, each string
+    // preceded by its size; take that layout from boost with a placeholder id
+    // and an empty content, then patch the id and size once they're known
+    static const string placeholder(40, '0');
+    static const string layout = [] {
+        Blob empty;
+        empty.id = placeholder;
+        std::ostringstream os;
+        {
+            boost::archive::binary_oarchive oa(os);
+            const Blob &obj = empty;
+            oa << obj;
+        }
+        return os.str();
+    }();
+    static const size_t idOffset = layout.find(placeholder);
+    static const size_t sizeOffset = layout.size() - sizeof(size_t);
+
+    std::error_code ec;
+    if (fs::file_size(file, ec) >= chunkThreshold && !ec) {
+        return saveChunks(file, created);
+    }
+    trace::Scope scope("hash");
+    ifstream is(file, ios::binary);
+    if (!is.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    fs::path tmp = utils::tempFile(dir);
+    ofstream os(tmp, ios::binary);
+    if (!os.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    os.write(layout.data(), layout.size());
+    utils::Hasher hash;
+    size_t size = 0;
+    std::unique_ptr<char[]> buf(new char[utils::chunkSize]);
+    while (is.read(buf.get(), utils::chunkSize) || is.gcount() > 0) {
+        hash.update(buf.get(), is.gcount());
+        os.write(buf.get(), is.gcount());
+        size += is.gcount();
+    }
+    string blobID = hash.final();
+    os.seekp(idOffset);
+    os.write(blobID.data(), blobID.size());
+    os.seekp(sizeOffset);
+    os.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    os.close();
+    if (!os) {
+        fs::remove(tmp);
+        throw runtime_error("cannot write the file");
+    }
+    bool saved = utils::objectExists(dir, blobID);
+    if (saved) {
+        fs::remove(tmp);
+    } else {
+        codec::encodeFile(tmp);
+        utils::replaceFile(tmp, utils::newObjectPath(dir, blobID));
+        trace::count(trace::objectsWritten);
+    }
+    if (created) {
+        *created = !saved;
+    }
+    return blobID;
+}
+
+// a chunked blob lists its chunks, which are blobs of their own, and its id
+// is the hash of the whole file like that of any blob
+string Blob::saveChunks(const fs::path &file, bool *created) {
+    trace::Scope scope("hash");
+    ifstream is(file, ios::binary);
+    if (!is.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    Blob list;
+    utils::Hasher hash;
+    string pending;    // read, not cut into chunks yet from start on
+    size_t start = 0;  // the part before is only dropped when refilling
+    auto cut = [&]() {
+        std::string_view rest(pending);
+        rest.remove_prefix(start);
+        Blob piece(string(rest.substr(0, chunk::cut(rest))));
+        if (!utils::objectExists(dir, piece.id)) {
+            utils::saveObject(piece, dir, piece.id);
+        }
+        start += piece.content.size();
+        list.chunks.push_back(std::move(piece.id));
+    };
+    std::unique_ptr<char[]> buf(new char[utils::chunkSize]);
+    while (is.read(buf.get(), utils::chunkSize) || is.gcount() > 0) {
+        hash.update(buf.get(), is.gcount());
+        pending.erase(0, start);
+        start = 0;
+        pending.append(buf.get(), is.gcount());
+        while (pending.size() - start >= chunk::maxSize) {
+            cut();
+        }
+    }
+    while (start != pending.size()) {
+        cut();
+    }
+    list.id = hash.final();
+    bool saved = utils::objectExists(dir, list.id);
+    if (!saved) {
+        utils::saveObject(list, dir, list.id);
+    }
+    if (created) {
+        *created = !saved;
+    }
+    return list.id;
+}
+
+utils::LRUCache<string, std::shared_ptr<const Blob::Resolved>>
+    Blob::baseCache(32);
+
+std::shared_ptr<const Blob::Resolved> Blob::resolve(const string &id,
+                                                    bool chunked) {
+    vector<Blob> deltas;  // from id down to a whole or cached blob
+    string cur = id;
+    std::shared_ptr<const Resolved> r;
+    while (!r) {
+        if (baseCache.get(cur, r)) {
+            break;
+        }
+        Blob blob;
+        utils::loadObject(blob, dir, cur);
+        if (!blob.chunks.empty()) {
+            if (!chunked) {
+                return nullptr;
+            }
+            string content;
+            for (const auto &c : blob.chunks) {
+                content.append(loadContent(c));
+            }
+            r = std::make_shared<const Resolved>(
+                Resolved{std::move(content), 0});
+        } else if (blob.base.empty()) {
+            r = std::make_shared<const Resolved>(
+                Resolved{std::move(blob.content), 0});
+            if (!deltas.empty()) {
+                baseCache.put(cur, r);
+            }
+        } else if (deltas.size() > maxDepth) {
+            throw runtime_error("delta chain is too long");
+        } else {
+            cur = blob.base;
+            deltas.push_back(std::move(blob));
+        }
+    }
+    for (auto iter = deltas.rbegin(); iter != deltas.rend(); ++iter) {
+        r = std::make_shared<const Resolved>(Resolved{
+            delta::apply(r->content, iter->content), r->depth + 1});
+        baseCache.put(iter->id, r);
+    }
+    return r;
+}
+
+string Blob::loadContent(const string &id) { return resolve(id)->content; }
+
+void Blob::writeFile(const string &id, const fs::path &file) {
+    Blob blob;
+    utils::loadObject(blob, dir, id);
+    if (blob.chunks.empty()) {
+        utils::writeFile(file,
+                         blob.base.empty() ? blob.content : loadContent(id));
+        return;
+    }
+    ofstream os(file, ios::binary | ios::trunc);
+    if (!os.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    for (const auto &c : blob.chunks) {
+        string content = loadContent(c);
+        os.write(content.data(), content.size());
+    }
+    if (!os) {
+        throw runtime_error("cannot write the file");
+    }
+}
+
+void Blob::deltify(const string &id, const string &baseID) {
+    fs::path file = utils::objectPath(dir, id);
+    std::error_code ec;
+    auto size = fs::file_size(utils::currentPath(file), ec);
+    if (ec || size > maxDeltaSize) {
+        return;
+    }
+    Blob blob;
+    utils::loadObject(blob, dir, id);
+    if (!blob.base.empty() || !blob.chunks.empty()) {
+        return;
+    }
+    // a chunked base isn't joined, it may be as large as any file
+    auto base = resolve(baseID, false);
+    if (!base || base->depth >= maxDepth ||
+        base->content.size() > maxDeltaSize) {
+        return;
+    }
+    string d = delta::create(base->content, blob.content);
+    if (d.size() * 2 > blob.content.size()) {  // not worth a chain
+        return;
+    }
+    blob.base = baseID;
+    blob.depth = base->depth + 1;
+    blob.content = std::move(d);
+    utils::save(blob, file);
+}
+
+bool Merge::isLegal(const vector<string> &args) const {
+    if (!fs::exists(".gitlet")) {
+        throw runtime_error("Not in an initialized Gitlet directory");
+    }
+    return args.size() == 3;
+}
+
+// a file of a three-way merge and its blob on each side, empty where the
+// side doesn't have it
+struct MergedFile {
+    std::string_view file, split, head, other;
+};
+
+// walks the sorted files of a commit, for merge-joins
+class FileCursor {
+  public:
+    explicit FileCursor(const Commit &c)
+        : iter(c.getFiles().begin()), end(c.getFiles().end()) {}
+    bool done() const { return !(iter != end); }
+    std::string_view name() const { return (*iter).first; }
+    // the blob of file if it's the next one, moving past it, otherwise an
+    // empty view
+    std::string_view take(std::string_view file) {
+        if (done() || name() != file) {
+            return {};
+        }
+        std::string_view id = (*iter).second;
+        ++iter;
+        return id;
+    }
+
+  private:
+    Commit::Files::iterator iter, end;
+};
+
+void Merge::exec(Gitlet &git, const vector<string> &args) {
+    string branch = args[2];
+    string curBranch = git.getCurBranch();
+    if (!git.isStageEmpty() || !git.isRemovedEmpty()) {
+        throw runtime_error("You have uncommitted changes.");
+    }
+    string otherID = git.getBranchCommitID(branch);
+    if (otherID.empty()) {
+        throw runtime_error("A branch with that name does not exist.");
+    }
+    if (branch == curBranch) {
+        throw runtime_error("Cannot merge a branch with itself.");
+    }
+    string headID = git.getHead();
+    CommitGraph graph;
+    uint32_t headPos = graph.lookup(headID);
+    uint32_t otherPos = graph.lookup(otherID);
+    uint32_t base = graph.mergeBase(headPos, otherPos);
+    if (base == otherPos) {
+        cout << "Given branch is an ancestor of the current branch." << endl;
+        return;
+    }
+    if (base == headPos) {
+        vector<string> working;
+        listWorkingFiles(".", working);
+        for (const auto &file : working) {
+            if (Checkout::isUntracked(git, file)) {
+                throw runtime_error(
+                    "There is an untracked file in the way; delete it, or "
+                    "add and commit it first.");
+            }
+        }
+        Checkout::takeCommitFiles(headID, otherID);
+        git.setHead(otherID);
+        git.insertBranchCommit(curBranch, otherID);
+        cout << "Current branch fast-forwarded." << endl;
+        return;
+    }
+    // three-way merge of the file lists, comparing blob ids only; the lists
+    // are sorted by name, so they're joined in one pass
+    auto head = Commit::load(headID);
+    auto other = Commit::load(otherID);
+    std::shared_ptr<const Commit> split = std::make_shared<const Commit>();
+    if (base != CommitGraph::none) {
+        split = Commit::load(graph.getID(base));
+    }
+    FileCursor s(*split), h(*head), o(*other);
+    vector<MergedFile> taken, removed, conflicted;
+    while (!s.done() || !h.done() || !o.done()) {
+        std::string_view file;
+        for (const auto *c : {&s, &h, &o}) {
+            if (!c->done() && (file.empty() || c->name() < file)) {
+                file = c->name();
+            }
+        }
+        MergedFile f = {file, s.take(file), h.take(file), o.take(file)};
+        if (f.head == f.other || f.split == f.other) {
+            // same on both sides or only head changed
+        } else if (f.split == f.head) {  // only the given branch changed
+            (f.other.empty() ? removed : taken).push_back(f);
+        } else {
+            conflicted.push_back(f);
+        }
+    }
+    // nothing is written before we know no untracked file is in the way
+    for (const auto *files : {&taken, &removed, &conflicted}) {
+        for (const auto &f : *files) {
+            if (f.head.empty() && fs::is_regular_file(f.file)) {
+                throw runtime_error(
+                    "There is an untracked file in the way; delete it, or "
+                    "add and commit it first.");
+            }
+        }
+    }
+    // the new commit is the tree of head with the merged files changed
+    std::map<string, string> changes;
+    Index index;
+    for (const auto &f : taken) {
+        string file(f.file), id(f.other);
+        makeParentDirs(file);
+        Blob::writeFile(id, file);
+        index.update(file, id);
+        changes[file] = id;
+    }
+    for (const auto &f : removed) {
+        string file(f.file);
+        removeWorkingFile(file);
+        index.erase(file);
+        changes[file] = string();
+    }
+    for (const auto &f : conflicted) {
+        string file(f.file);
+        Blob merged(conflict(string(f.head), string(f.other)));
+        utils::saveObject(merged, Blob::getDir(), merged.getID());
+        makeParentDirs(file);
+        utils::writeFile(file, merged.getContent());
+        index.update(file, merged.getID());
+        changes[file] = merged.getID();
+    }
+    index.save();
+    Commit newCommit("Merged " + branch + " into " + curBranch + ".",
+                     Tree::update(Tree::of(*head), changes), headID, otherID);
+    string newHead = newCommit.getID();
+    newCommit.save();
+    graph.add(newCommit);
+    graph.save();
+    git.setHead(newHead);
+    git.insertBranchCommit(curBranch, newHead);
+    if (!conflicted.empty()) {
+        cout << "Encountered a merge conflict." << endl;
+    }
+}
+
+// content of a conflicted file, a deleted side is empty
+string Merge::conflict(const string &headID, const string &otherID) {
+    string content = "<<<<<<< HEAD\n";
+    if (!headID.empty()) {
+        content.append(Blob::loadContent(headID));
+    }
+    content.append("=======\n");
+    if (!otherID.empty()) {
+        content.append(Blob::loadContent(otherID));
+    }
+    content.append(">>>>>>>\n");
+    return content;
+}
+
+bool Repack::isLegal(const vector<string> &args) const {
+    if (!fs::exists(".gitlet")) {
+        throw runtime_error("Not in an initialized Gitlet directory");
+    }
+    return args.size() == 2;
+}
+
+// move loose commits, trees and blobs into packs and write the bitmaps of
+// what the branches reach
+void Repack::exec(Gitlet &git, const vector<string> &args) {
+    pack::repack(Commit::getDir());
+    if (fs::is_directory(Tree::getDir())) {
+        pack::repack(Tree::getDir());
+    }
+    pack::repack(Blob::getDir());
+    bitmap::Bitmaps::write(branchTips(git));
+}
+
+bool CountObjects::isLegal(const vector<string> &args) const {
+    if (!fs::exists(".gitlet")) {
+        throw runtime_error("Not in an initialized Gitlet directory");
+    }
+    return args.size() <= 4;
+}
+
+void CountObjects::exec(Gitlet &git, const vector<string> &args) {
+    vector<string> tips[2];
+    for (size_t i = 2; i != args.size(); ++i) {
+        string id = git.getBranchCommitID(args[i]);
+        if (id.empty()) {
+            throw runtime_error("No such branch exists");
+        }
+        tips[i - 2].push_back(id);
+    }
+    if (args.size() == 2) {
+        tips[0] = branchTips(git);
+    }
+    bitmap::Bitmaps bitmaps;
+    bitmap::Reachable r = bitmaps.reachable(tips[0]);
+    if (!tips[1].empty()) {
+        r.subtract(bitmaps.reachable(tips[1]));
+    }
+    cout << r.count(bitmap::commitKind) << " commits, "
+         << r.count(bitmap::treeKind) << " trees, "
+         << r.count(bitmap::blobKind) << " blobs" << endl;
+}
+
+const std::filesystem::path Gc::cursorFile = ".gitlet/gc";
+
+bool Gc::isLegal(const vector<string> &args) const {
+    if (!fs::exists(".gitlet")) {
+        throw runtime_error("Not in an initialized Gitlet directory");
+    }
+    return args.size() == 2 || (args.size() == 3 && args[2] == "--now");
+}
+
+namespace {
+// the loose objects removed by a sweep
+struct Swept {
+    size_t objects = 0;
+    std::uintmax_t bytes = 0;
+};
+}  // namespace
+
+// remove the loose objects of a kind in shard dir, whose ids start with
+// prefix, that aren't reachable and were written before cutoff
+static void sweepShard(const fs::path &dir, const string &prefix,
+                       const bitmap::Reachable &reachable, bitmap::Kind kind,
+                       fs::file_time_type cutoff, Swept &swept) {
+    string id, raw;
+    for (auto &iter : fs::directory_iterator(dir)) {
+        id = prefix + iter.path().filename().string();
+        if (!iter.is_regular_file() || id.size() != 40 ||
+            !utils::fromHex(id, raw) || reachable.contains(kind, id)) {
+            continue;
+        }
+        trace::count(trace::filesStated);
+        std::error_code ec;
+        if (iter.last_write_time(ec) >= cutoff || ec) {
+            continue;  // may be written by a command still running
+        }
+        std::uintmax_t size = iter.file_size(ec);
+        // nothing refers to the object, so it's removed right away rather
+        // than at the commit, which would hold every removal until the end
+        if (!ec && fs::remove(iter.path(), ec)) {
+            ++swept.objects;
+            swept.bytes += size;
+        }
+    }
+}
+
+void Gc::exec(Gitlet &git, const vector<string> &args) {
+    utils::Config config;
+    int grace =
+        args.size() == 3 ? 0 : config.getInt("gc.grace", 14 * 24 * 60 * 60);
+    int sweepTime = config.getInt("gc.sweepTime", 10000);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(sweepTime);
+    // no other command runs while objects are removed, one may rely on an
+    // unreachable object it found; the state they saved is marked from too,
+    // git may have been loaded before
+    vector<string> tips = branchTips(git), staged;
+    for (const auto &i : git.getStagedBlob()) {
+        staged.push_back(i.second);
+    }
+    if (utils::Transaction *tx = utils::Transaction::current()) {
+        tx->lockExclusive();
+        if (fs::exists(Gitlet::getFile())) {
+            Gitlet saved;
+            utils::load(saved, Gitlet::getFile());
+            vector<string> more = branchTips(saved);
+            tips.insert(tips.end(), more.begin(), more.end());
+            for (const auto &i : saved.getStagedBlob()) {
+                staged.push_back(i.second);
+            }
+        }
+    }
+    // the commits, trees and blobs reachable from the branches, with the
+    // chunks and the bases of deltas of their blobs and of the staged ones;
+    // the bitmaps written by repack spare walking most of them
+    bitmap::Bitmaps bitmaps;
+    bitmap::Reachable reachable = bitmaps.reachable(tips, staged);
+
+    trace::Scope scope("sweep");
+    // a step sweeps the flat objects of an object directory or one of its
+    // 256 shards; the sweep stops after the first step past the deadline
+    const std::pair<fs::path, bitmap::Kind> dirs[] = {
+        {Commit::getDir(), bitmap::commitKind},
+        {Tree::getDir(), bitmap::treeKind},
+        {Blob::getDir(), bitmap::blobKind}};
+    const size_t steps = 257;
+    size_t step = 0;
+    if (fs::exists(cursorFile)) {
+        ifstream is(cursorFile);
+        is >> step;
+    }
+    auto cutoff =
+        fs::file_time_type::clock::now() - std::chrono::seconds(grace);
+    Swept swept;
+    for (; step < 3 * steps; ++step) {
+        fs::path dir = dirs[step / steps].first;
+        string prefix;
+        if (step % steps != 0) {
+            char shard[3];
+            snprintf(shard, sizeof(shard), "%02X",
+                     unsigned(step % steps - 1));
+            prefix = shard;
+            dir /= prefix;
+        }
+        if (!fs::is_directory(dir)) {
+            continue;
+        }
+        sweepShard(dir, prefix, reachable, dirs[step / steps].second, cutoff,
+                   swept);
+        if (std::chrono::steady_clock::now() >= deadline) {
+            ++step;
+            break;
+        }
+    }
+    cout << "Removed " << swept.objects << " unreachable objects, reclaimed "
+         << swept.bytes << " bytes" << endl;
+    if (step < 3 * steps) {
+        fs::path tmp = utils::tempFile(".gitlet");
+        ofstream(tmp) << step << '\n';
+        utils::replaceFile(tmp, cursorFile);
+        cout << "Run gc again to sweep the rest" << endl;
+    } else if (fs::exists(cursorFile)) {
+        utils::removeFile(cursorFile);
+    }
+}
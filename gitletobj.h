@@ -4,16 +4,31 @@
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/unordered_set.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
+
+#include "lru.h"
+#include "trace.h"
+#include "utils.h"
 namespace gitlet {
 namespace gitlet_obj {
+class Commit;
+
 class GitletObj {
   public:
     void setID(std::string _id) { id = _id; }
@@ -31,9 +46,16 @@ class GitletObj {
     }
 };
 
+// The repository state, saved to ".gitlet/info/state". Its setters mark it
+// dirty when they change something, so a command that changed nothing
+// doesn't save it.
 class Gitlet : public GitletObj {
   public:
     static std::filesystem::path getDir() { return dir; }
+    static std::filesystem::path getFile() { return dir / "state"; }
+    bool isDirty() const { return dirty; }
+    // the state matches its file again
+    void markClean() { dirty = false; }
     std::string getHead() const { return head; }
     std::string getCurBranch() const { return curBranch; }
     // get commit hash using branch name, if not exists, return an empty string
@@ -53,22 +75,38 @@ class Gitlet : public GitletObj {
         }
     }
     void insertBranchCommit(std::string branch, std::string id) {
-        branchCommit[branch] = id;
+        std::string &old = branchCommit[branch];
+        if (old != id) {
+            old = id;
+            dirty = true;
+        }
     }
     void eraseBranchCommit(std::string branch) {
         auto iter = branchCommit.find(branch);
         if (iter != branchCommit.end()) {
             branchCommit.erase(iter);
+            dirty = true;
         }
     }
     std::unordered_map<std::string, std::string> getBranchCommit() const {
         return branchCommit;
     }
-    void insertRemovedBlob(std::string file) { removedBlob.insert(file); }
+    // full id of the commit a full or shortened id refers to, found through
+    // the commit-graph; if no commit or several ones match, throw a
+    // runtime_error
+    std::string resolveCommitID(const std::string &prefix) const;
+    void insertRemovedBlob(std::string file) {
+        dirty |= removedBlob.insert(file).second;
+    }
+    void clearRemovedBlob() {
+        dirty |= !removedBlob.empty();
+        removedBlob.clear();
+    }
     void eraseRemovedBlob(std::string file) {
         auto iter = removedBlob.find(file);
         if (iter != removedBlob.end()) {
             removedBlob.erase(iter);
+            dirty = true;
         }
     }
     bool isRemoved(std::string file) const {
@@ -80,23 +118,37 @@ class Gitlet : public GitletObj {
     }
 
     void insertStagedBlob(std::string file, std::string id) {
-        stagedBlob[file] = id;
+        std::string &old = stagedBlob[file];
+        if (old != id) {
+            old = id;
+            dirty = true;
+        }
     }
     void eraseStagedBlob(std::string file) {
         auto iter = stagedBlob.find(file);
         if (iter != stagedBlob.end()) {
             stagedBlob.erase(iter);
+            dirty = true;
         }
     }
 
-    void clearStagedBlob() { stagedBlob.clear(); }
+    void clearStagedBlob() {
+        dirty |= !stagedBlob.empty();
+        stagedBlob.clear();
+    }
     std::unordered_map<std::string, std::string> getStagedBlob() const {
         return stagedBlob;
     }
     bool isRemovedEmpty() const { return removedBlob.empty(); }
     bool isStageEmpty() const { return stagedBlob.empty(); }
-    void setHead(std::string h) { head = h; }
-    void setCurBranch(std::string cb) { curBranch = cb; }
+    void setHead(std::string h) {
+        dirty |= head != h;
+        head = h;
+    }
+    void setCurBranch(std::string cb) {
+        dirty |= curBranch != cb;
+        curBranch = cb;
+    }
 
   private:
     std::string head;       // head pointer
@@ -106,6 +158,7 @@ class Gitlet : public GitletObj {
     std::unordered_set<std::string> removedBlob;  // file name of removed blob
     std::unordered_map<std::string, std::string>
         stagedBlob;  // mapping of file name to blob hash
+    bool dirty = false;  // changed since loaded or saved, not serialized
 
     static const std::filesystem::path dir;
 
@@ -125,6 +178,9 @@ class Command {
   public:
     virtual void exec(Gitlet &git, const std::vector<std::string> &args) = 0;
     virtual bool isLegal(const std::vector<std::string> &args) const = 0;
+    // whether the command only reads the repository, so it runs without a
+    // transaction and the state isn't saved after it
+    virtual bool isReadOnly() const { return false; }
     virtual ~Command() = default;
 };
 
@@ -138,6 +194,9 @@ class Add : public Command {
   public:
     void exec(Gitlet &git, const std::vector<std::string> &args) override;
     bool isLegal(const std::vector<std::string> &args) const override;
+
+  private:
+    std::vector<std::string> listFiles(const std::vector<std::string> &args);
 };
 
 class CommitCmd : public Command {
@@ -154,27 +213,28 @@ class Rm : public Command {
 
 class AbstractLog : public Command {
   public:
-    void printLog(const std::string &);
+    // print commit id, unless it's cached it's read into c, whose memory is
+    // reused from one commit to the next
+    void printLog(const std::string &id, Commit &c);
 };
 
 class Log : public AbstractLog {
   public:
     void exec(Gitlet &git, const std::vector<std::string> &args) override;
     bool isLegal(const std::vector<std::string> &args) const override;
+    bool isReadOnly() const override { return true; }
 };
 
 class GlobalLog : public AbstractLog {
   public:
     void exec(Gitlet &git, const std::vector<std::string> &args) override;
     bool isLegal(const std::vector<std::string> &args) const override;
-
-  private:
-    void addCommits(const std::string &);
-    bool isVisited(const std::string &);
-
-    std::unordered_set<std::string> commits;
+    bool isReadOnly() const override { return true; }
 };
 
+// Not read-only: the stat cache of the index is saved when files were
+// rehashed, which goes through a transaction like other writes. The state
+// isn't saved, as status doesn't change it.
 class Status : public Command {
   public:
     void exec(Gitlet &git, const std::vector<std::string> &args) override;
@@ -190,12 +250,12 @@ class Checkout : public Command {
   public:
     void exec(Gitlet &git, const std::vector<std::string> &args) override;
     bool isLegal(const std::vector<std::string> &args) const override;
+    // also used by merge
+    static void takeCommitFiles(const std::string &head, const std::string &id);
+    static bool isUntracked(Gitlet &git, std::string file);
 
   private:
-    void takeCommitFiles(std::string id);
     void takeCommitFile(std::string id, std::string file);
-    bool isUntracked(Gitlet &git, std::string file);
-    std::string getTotalID(std::string id);
 };
 
 class Branch : public Command {
@@ -204,6 +264,48 @@ class Branch : public Command {
     bool isLegal(const std::vector<std::string> &args) const override;
 };
 
+class Merge : public Command {
+  public:
+    void exec(Gitlet &git, const std::vector<std::string> &args) override;
+    bool isLegal(const std::vector<std::string> &args) const override;
+
+  private:
+    std::string conflict(const std::string &headID,
+                         const std::string &otherID);
+};
+
+class Repack : public Command {
+  public:
+    void exec(Gitlet &git, const std::vector<std::string> &args) override;
+    bool isLegal(const std::vector<std::string> &args) const override;
+};
+
+// Counts the commits, trees and blobs reachable from the branches, from a
+// branch, or from a branch but not from another.
+class CountObjects : public Command {
+  public:
+    void exec(Gitlet &git, const std::vector<std::string> &args) override;
+    bool isLegal(const std::vector<std::string> &args) const override;
+    bool isReadOnly() const override { return true; }
+};
+
+// Garbage collection: marks the commits, trees and blobs reachable from the
+// branches and the staging area, with the bases of their deltas, then removes
+// the loose objects not marked and older than the grace period, "gc.grace"
+// seconds in the config, two weeks by default, none with "--now". The sweep
+// goes shard by shard and stops after "gc.sweepTime" milliseconds, the next
+// gc goes on from the shard it stopped at. It waits for the commands writing
+// the repository in other processes and keeps new ones waiting until it ends.
+class Gc : public Command {
+  public:
+    void exec(Gitlet &git, const std::vector<std::string> &args) override;
+    bool isLegal(const std::vector<std::string> &args) const override;
+    static std::filesystem::path getCursorFile() { return cursorFile; }
+
+  private:
+    static const std::filesystem::path cursorFile;  // shard to go on from
+};
+
 class CommandExecutor {
   public:
     CommandExecutor() {
@@ -218,93 +320,288 @@ class CommandExecutor {
         ptrCommand.insert(
             {"checkout", std::unique_ptr<Command>(new Checkout())});
         ptrCommand.insert({"branch", std::unique_ptr<Command>(new Branch())});
+        ptrCommand.insert({"merge", std::unique_ptr<Command>(new Merge())});
+        ptrCommand.insert({"repack", std::unique_ptr<Command>(new Repack())});
+        ptrCommand.insert({"gc", std::unique_ptr<Command>(new Gc())});
+        ptrCommand.insert(
+            {"count-objects", std::unique_ptr<Command>(new CountObjects())});
     }
     void execCommand(Gitlet &git, const std::vector<std::string> &args) {
-        std::string command = args[1];
-        if (ptrCommand.find(command) != ptrCommand.end() &&
-            ptrCommand.at(command)->isLegal(args)) {
-            ptrCommand.at(command)->exec(git, args);
+        auto iter = ptrCommand.find(args[1]);
+        if (iter != ptrCommand.end() && iter->second->isLegal(args)) {
+            trace::Scope scope(iter->first.c_str(), "command");
+            iter->second->exec(git, args);
         } else {
             throw std::runtime_error("command is illegal");
         }
     }
+    // whether command only reads the repository, false if it's unknown
+    bool isReadOnly(const std::string &command) const {
+        auto iter = ptrCommand.find(command);
+        return iter != ptrCommand.end() && iter->second->isReadOnly();
+    }
 
   private:
     std::unordered_map<std::string, std::unique_ptr<Command>> ptrCommand;
 };
 
+// A directory of a commit: its entries sorted by name, each a file with its
+// blob id or a subdirectory, whose name ends with '/', with its tree id. The
+// slash sorts a directory among the files the way its paths sort, so the
+// files of nested trees come out in path order. A tree is stored flat like a
+// commit:
+//   header:  "GTRE", version, number of entries (u32 each)
+//   offsets: where each string starts, and where the last one ends (u32
+//            each): the name and id of each entry
+//   the strings back to back
+// Its id is the hash of those bytes, so a directory that didn't change is
+// the same object in every commit and isn't saved again.
+class Tree {
+  public:
+    // name and id of an entry
+    using Entry = std::pair<std::string_view, std::string_view>;
+    // called with the path of a file and its blob ids in two trees
+    using DiffFunc = std::function<void(
+        const std::string &, std::string_view, std::string_view)>;
+    // called with the path of a file and its blob id
+    using WalkFunc =
+        std::function<void(const std::string &, std::string_view)>;
+
+    Tree() = default;
+    Tree(const Tree &) = delete;
+    Tree &operator=(const Tree &) = delete;
+    std::size_t size() const;
+    Entry getEntry(std::size_t i) const;
+    // id of the entry name, "dir/" for a subdirectory, or an empty view
+    std::string_view find(std::string_view name) const;
+    static std::filesystem::path getDir() { return dir; }
+    // load a tree through a bounded in-process cache, the empty id is the
+    // tree without entries; if cannot find it, throw a runtime_error
+    static std::shared_ptr<const Tree> load(const std::string &id);
+    // id of tree root with changes applied, each path mapped to its new blob
+    // id or to an empty string to remove it; only the trees along the changed
+    // paths are saved and directories left empty disappear; if a path is
+    // malformed, throw a runtime_error
+    static std::string update(
+        const std::string &root,
+        const std::map<std::string, std::string> &changes);
+    // id of the tree of a commit, the tree of a commit saved by boost, before
+    // trees, is saved from its file list
+    static std::string of(const Commit &c);
+    // call f for each file whose blob differs between trees from and to, in
+    // path order, with an empty id on a side without it; subtrees with the
+    // same id on both sides are skipped
+    static void diff(const std::string &from, const std::string &to,
+                     const DiffFunc &f);
+    // call f for each file of the tree, in path order
+    static void walk(const std::string &id, const WalkFunc &f);
+
+  private:
+    utils::MappedFile mapped;  // the stored bytes if they're used in place
+    std::string buffer;        // otherwise
+    std::string_view data;     // flat bytes, in mapped or buffer
+    static const std::filesystem::path dir;
+
+    using Changes = std::map<std::string, std::string>::const_iterator;
+    static std::string update(const std::string &id, Changes begin,
+                              Changes end, std::size_t prefix);
+    static void diff(const std::string &from, const std::string &to,
+                     const std::string &prefix, const DiffFunc &f);
+    static void walk(const std::string &id, const std::string &prefix,
+                     const WalkFunc &f);
+};
+
+// A commit is stored flat, so it's used in place once mapped:
+//   header:  "GCMT", version, number of files (u32 each)
+//   offsets: where each string starts, and where the last one ends (u32
+//            each): log, timestamp, parent1, parent2, then the id of the tree
+//            of its files
+//   the strings back to back
+// Accessors are views into those bytes and don't allocate. The files are
+// listed from the tree the first time they're needed. Commits saved by boost
+// before have no tree, they're converted when loaded and their files listed
+// right away.
 class Commit : public GitletObj {
   public:
+    // name and blob id of a file of the commit
+    using File = std::pair<std::string_view, std::string_view>;
+    // files of a commit sorted by path
+    class Files {
+      public:
+        class iterator {
+          public:
+            iterator(const Commit *c, std::size_t i) : c(c), i(i) {}
+            File operator*() const { return c->getFile(i); }
+            iterator &operator++() {
+                ++i;
+                return *this;
+            }
+            bool operator!=(const iterator &other) const {
+                return i != other.i;
+            }
+
+          private:
+            const Commit *c;
+            std::size_t i;
+        };
+        explicit Files(const Commit *c) : c(c) {}
+        iterator begin() const { return iterator(c, 0); }
+        iterator end() const { return iterator(c, size()); }
+        std::size_t size() const { return c->fileCount(); }
+
+      private:
+        const Commit *c;
+    };
+
     Commit() = default;
+    Commit(const Commit &) = delete;
+    Commit &operator=(const Commit &) = delete;
     explicit Commit(const std::string &log);
+    // a commit of the given files, their trees are saved
     explicit Commit(
         const std::string &log,
         const std::unordered_map<std::string, std::string> &commitBlob,
         const std::string &parent1,
         const std::string &parent2 = std::string());
-    std::string getLog() const { return log; }
-    std::string getTimeStamp() const { return timestamp; }
-    std::unordered_map<std::string, std::string> getCommitBlob() const {
-        return commitBlob;
-    }
-    std::string getParent1() const { return parent1; }
-    std::string getParent2() const { return parent2; }
-    std::string getBlobID(std::string file) {
-        if (commitBlob.find(file) != commitBlob.end()) {
-            return commitBlob[file];
-        } else {
-            return {};
-        }
-    }
-    bool blobExists(std::string id) {
-        for (auto iter = commitBlob.begin(); iter != commitBlob.end(); ++iter) {
-            if (iter->second == id) {
-                return true;
-            }
-        }
-        return false;
+    // a commit of the files of a saved tree
+    explicit Commit(const std::string &log, const std::string &tree,
+                    const std::string &parent1,
+                    const std::string &parent2 = std::string());
+    std::string_view getLog() const { return field(logField); }
+    std::string_view getTimeStamp() const { return field(timestampField); }
+    // timestamp as seconds since the epoch
+    std::int64_t getTime() const;
+    Files getFiles() const {
+        list();
+        return Files(this);
     }
+    std::string_view getParent1() const { return field(parent1Field); }
+    std::string_view getParent2() const { return field(parent2Field); }
+    // id of the tree of the files, empty if there are none or the commit was
+    // saved by boost, before trees
+    std::string_view getTree() const;
+    // blob id of a file, or an empty view if the commit doesn't have it
+    std::string_view getBlobID(std::string_view file) const;
+    // whether a file of the commit has blob id, through a sorted index of the
+    // blob ids built by the first call
+    bool blobExists(std::string_view id) const;
     static std::filesystem::path getDir() { return dir; }
+    // save the commit as an object of getDir()
+    void save() const;
+    // load a commit through a bounded in-process cache, the commit is shared
+    // and immutable, if cannot find it, throw a runtime_error
+    static std::shared_ptr<const Commit> load(const std::string &id);
+    // the cached commit id, or nullptr, it's not loaded on a miss
+    static std::shared_ptr<const Commit> cached(const std::string &id);
+    // load commit id into c, reusing the memory c holds, so that reading
+    // commit after commit doesn't allocate when they're loose and
+    // uncompressed; if cannot find it, throw a runtime_error
+    static void read(const std::string &id, Commit &c);
+    static utils::CacheStats getCacheStats();
 
   private:
-    std::string log;        // log message of commit
-    std::string timestamp;  // timestamp of commit
-    std::unordered_map<std::string, std::string>
-        commitBlob;       // mapping of file names to blob hash
-    std::string parent1;  // parent1 hash
-    std::string parent2;  // parent2 hash
+    enum { logField, timestampField, parent1Field, parent2Field, treeField };
+    utils::MappedFile mapped;  // the stored bytes if they're used in place
+    std::string buffer;        // otherwise
+    std::string_view data;     // flat bytes, in mapped or buffer
+    bool legacy = false;          // saved by boost, without a tree
+    mutable std::string listing;  // flat names and blob ids of the files
+    mutable std::atomic<bool> listed{false};
+    mutable std::vector<std::string_view> blobIndex;  // sorted blob ids
+    mutable bool indexed = false;
+    mutable std::mutex indexMutex;
     static const std::filesystem::path dir;
 
+    // check the flat bytes in data, if they're malformed, throw a
+    // runtime_error
+    void parse();
+    // take the stored bytes, converting the format of boost if needed
+    void assign(std::string_view stored);
+    std::string_view field(std::size_t i) const;
+    // make files hold the file list, once
+    void list() const;
+    std::size_t fileCount() const;
+    File getFile(std::size_t i) const;
     std::string getCurrentTime() const;
     std::string getEpochTime() const;
-
-    friend class boost::serialization::access;
-    template <class Archive>
-    void serialize(Archive &ar, const unsigned int version) {
-        ar &boost::serialization::base_object<GitletObj>(*this);
-        ar &log &timestamp &commitBlob;
-        ar &parent1 &parent2;
-    }
 };
 
 class Blob : public GitletObj {
   public:
     Blob() = default;
     Blob(std::string content);
+    // stored content: the file content, or a delta against getBase(), or
+    // empty if the content is made of chunks
     std::string getContent() const { return content; }
+    std::string getBase() const { return base; }
+    unsigned getDepth() const { return depth; }
+    // ids of the blobs holding the chunks of a large file, in order
+    const std::vector<std::string> &getChunks() const { return chunks; }
     static std::filesystem::path getDir() { return dir; }
+    // hash a working file and save it as a blob in the same pass, reading it
+    // chunk by chunk so memory use doesn't depend on the file size, return
+    // the blob id; created tells whether the blob wasn't saved before. Files
+    // from chunkThreshold bytes on are cut into content-defined chunks saved
+    // as blobs of their own, so the chunks an edit doesn't touch are shared.
+    static std::string saveFile(const std::filesystem::path &file,
+                                bool *created = nullptr);
+    // file content of a saved blob, applying the deltas along its chain of
+    // bases, recently rebuilt bases are cached; if cannot find the blob,
+    // throw a runtime_error
+    static std::string loadContent(const std::string &id);
+    // write the file content of a saved blob to file, a chunk at a time for
+    // a chunked blob; if cannot find the blob or write the file, throw a
+    // runtime_error
+    static void writeFile(const std::string &id,
+                          const std::filesystem::path &file);
+    // store a just created blob as a delta against base when that's much
+    // smaller and the chain of bases isn't too long already
+    static void deltify(const std::string &id, const std::string &base);
+
+    static const std::size_t maxDeltaSize = 1 << 24;  // larger blobs stay whole
+    static const unsigned maxDepth = 16;               // longest chain of bases
+    static const std::size_t chunkThreshold = 1 << 20;  // smaller stay whole
 
   private:
+    // a rebuilt content and the length of its chain of bases
+    struct Resolved {
+        std::string content;
+        unsigned depth;
+    };
+
+    std::string base;    // id of the blob content is a delta against
+    unsigned depth = 0;  // length of the chain of bases
+    std::vector<std::string> chunks;
     std::string content;
     static const std::filesystem::path dir;
+    // rebuilt contents of blobs that are bases of deltas
+    static utils::LRUCache<std::string, std::shared_ptr<const Resolved>>
+        baseCache;
+
+    // rebuild the content of a blob; if not chunked, return nullptr rather
+    // than join the chunks of a chunked blob
+    static std::shared_ptr<const Resolved> resolve(const std::string &id,
+                                                   bool chunked = true);
+    // saveFile() of a large file
+    static std::string saveChunks(const std::filesystem::path &file,
+                                  bool *created);
+
     friend class boost::serialization::access;
     template <class Archive>
     void serialize(Archive &ar, const unsigned int version) {
         ar &boost::serialization::base_object<GitletObj>(*this);
-        ar &content;
+        if (version > 0) {
+            ar &base &depth;
+        }
+        if (version > 1) {
+            ar &chunks;
+        }
+        ar &content;  // must stay last, see saveFile()
     }
 };
 }  // namespace gitlet_obj
 }  // namespace gitlet
 
+BOOST_CLASS_VERSION(gitlet::gitlet_obj::Blob, 2)
+
 #endif /* ifndef GITLETOBJ_H */
@@ -0,0 +1,161 @@
+#include "index.h"
+
+#include "journal.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <sys/stat.h>
+
+#include <ctime>
+#include <stdexcept>
+using namespace gitlet::gitlet_obj;
+using std::runtime_error;
+using std::string;
+using std::vector;
+
+namespace utils = gitlet::utils;
+namespace trace = gitlet::trace;
+namespace fs = std::filesystem;
+
+const std::filesystem::path Index::file = ".gitlet/index";
+
+// fill the stat fields of entry, return false if the file cannot be stat'ed
+static bool statFile(const string &path, IndexEntry &entry) {
+    struct stat st;
+    trace::count(trace::filesStated);
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    entry.mtimeSec = st.st_mtim.tv_sec;
+    entry.mtimeNsec = st.st_mtim.tv_nsec;
+    entry.ctimeSec = st.st_ctim.tv_sec;
+    entry.ctimeNsec = st.st_ctim.tv_nsec;
+    entry.size = st.st_size;
+    entry.ino = st.st_ino;
+    return true;
+}
+
+static bool sameStat(const IndexEntry &a, const IndexEntry &b) {
+    return a.mtimeSec == b.mtimeSec && a.mtimeNsec == b.mtimeNsec &&
+           a.ctimeSec == b.ctimeSec && a.ctimeNsec == b.ctimeNsec &&
+           a.size == b.size && a.ino == b.ino;
+}
+
+// entries of the index file last loaded or saved by this process, so a
+// process running many commands doesn't deserialize them each time; the file
+// is identified by inode, size and mtime, its ctime changes when a
+// transaction renames it into place
+static struct {
+    IndexEntry stamp;
+    std::map<string, IndexEntry> entries;
+} cached;
+
+static bool sameFile(const IndexEntry &a, const IndexEntry &b) {
+    return a.ino == b.ino && a.size == b.size && a.mtimeSec == b.mtimeSec &&
+           a.mtimeNsec == b.mtimeNsec;
+}
+
+Index::Index() {
+    IndexEntry stamp;
+    if (statFile(utils::currentPath(file), stamp)) {
+        if (sameFile(stamp, cached.stamp)) {
+            entries = cached.entries;
+        } else {
+            utils::load(entries, file);
+            cached.stamp = stamp;
+            cached.entries = entries;
+        }
+        stampSec = stamp.mtimeSec;
+        stampNsec = stamp.mtimeNsec;
+    }
+}
+
+// whether the mtime of entry is before the current timestamp tick, the tick
+// of a file written now, which the coarse clock gives
+static bool beforeNow(const IndexEntry &entry) {
+    timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    return entry.mtimeSec < now.tv_sec ||
+           (entry.mtimeSec == now.tv_sec && entry.mtimeNsec < now.tv_nsec);
+}
+
+bool Index::isRacy(const IndexEntry &entry) const {
+    return entry.mtimeSec > stampSec ||
+           (entry.mtimeSec == stampSec && entry.mtimeNsec >= stampNsec);
+}
+
+string Index::getBlobID(const string &path) {
+    return getBlobIDs({path}).front();
+}
+
+vector<string> Index::getBlobIDs(const vector<string> &paths) {
+    vector<IndexEntry> cur(paths.size());
+    vector<size_t> changed;
+    for (size_t i = 0; i != paths.size(); ++i) {
+        if (!statFile(paths[i], cur[i])) {
+            throw runtime_error("cannot open the file");
+        }
+        auto iter = entries.find(paths[i]);
+        if (iter != entries.end() && sameStat(iter->second, cur[i]) &&
+            !isRacy(iter->second)) {
+            cur[i].id = iter->second.id;
+        } else {
+            changed.push_back(i);
+        }
+    }
+    // stat before hashing, a change while hashing will show up next time
+    utils::parallelFor(changed.size(), [&](size_t i) {
+        cur[changed[i]].id = utils::hashFile(paths[changed[i]]);
+    });
+    for (size_t i : changed) {
+        auto iter = entries.find(paths[i]);
+        if (iter == entries.end() || !sameStat(iter->second, cur[i]) ||
+            iter->second.id != cur[i].id) {
+            entries[paths[i]] = cur[i];
+            dirty = true;
+        } else if (isRacy(iter->second) && beforeNow(cur[i])) {
+            // a racy entry found unchanged is written again, so the index
+            // file gets newer than it and it's trusted from then on
+            dirty = true;
+        }
+    }
+    vector<string> ids(paths.size());
+    for (size_t i = 0; i != paths.size(); ++i) {
+        ids[i] = std::move(cur[i].id);
+    }
+    return ids;
+}
+
+void Index::update(const string &path, const string &id) {
+    IndexEntry cur;
+    if (!statFile(path, cur)) {
+        erase(path);
+        return;
+    }
+    cur.id = id;
+    entries[path] = cur;
+    dirty = true;
+}
+
+void Index::erase(const string &path) {
+    if (entries.erase(path)) {
+        dirty = true;
+    }
+}
+
+void Index::clear() {
+    if (!entries.empty()) {
+        entries.clear();
+        dirty = true;
+    }
+}
+
+void Index::save() {
+    if (dirty) {
+        utils::save(entries, file);
+        dirty = false;
+        if (statFile(utils::currentPath(file), cached.stamp)) {
+            cached.entries = entries;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef INDEX_H
+#define INDEX_H
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gitlet {
+namespace gitlet_obj {
+// stat data of a working file when its blob id was last computed
+struct IndexEntry {
+    std::int64_t mtimeSec = 0;
+    std::int64_t mtimeNsec = 0;
+    std::int64_t ctimeSec = 0;
+    std::int64_t ctimeNsec = 0;
+    std::uint64_t size = 0;
+    std::uint64_t ino = 0;
+    std::string id;  // blob hash of the content
+
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+        ar &mtimeSec &mtimeNsec &ctimeSec &ctimeNsec;
+        ar &size &ino &id;
+    }
+};
+
+// Stat cache of tracked working files, so that a file is only rehashed when
+// its stat data changed. Like git, an entry whose mtime is not older than the
+// index file itself is "racily clean": the file may have been modified in the
+// same timestamp tick after it was hashed, so it's rehashed until the index
+// is written in a later tick.
+class Index {
+  public:
+    // load the index file if it exists
+    Index();
+    static std::filesystem::path getFile() { return file; }
+    // blob id of the content of a working file, from the cache if its stat
+    // data didn't change, if cannot open the file, throw a runtime_error
+    std::string getBlobID(const std::string &path);
+    // getBlobID() of many files, those whose stat data changed are hashed on
+    // all cores
+    std::vector<std::string> getBlobIDs(const std::vector<std::string> &paths);
+    // record that a working file has just been written or hashed as blob id
+    void update(const std::string &path, const std::string &id);
+    void erase(const std::string &path);
+    void clear();
+    // write the index file if anything changed
+    void save();
+
+  private:
+    std::map<std::string, IndexEntry> entries;
+    std::int64_t stampSec = 0;  // mtime of the index file when loaded
+    std::int64_t stampNsec = 0;
+    bool dirty = false;
+    static const std::filesystem::path file;
+
+    bool isRacy(const IndexEntry &entry) const;
+};
+}  // namespace gitlet_obj
+}  // namespace gitlet
+
+#endif /* ifndef INDEX_H */
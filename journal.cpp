@@ -0,0 +1,254 @@
+#include "journal.h"
+
+#include "trace.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <set>
+#include <stdexcept>
+#include <string>
+namespace fs = std::filesystem;
+namespace utils = gitlet::utils;
+namespace trace = gitlet::trace;
+using fs::path;
+using std::runtime_error;
+using std::size_t;
+using std::string;
+using utils::Transaction;
+
+Transaction *Transaction::active = nullptr;
+const path Transaction::dir = ".gitlet/journal";
+
+// flush a file or directory to disk
+static void syncPath(const path &p, bool data) {
+    int fd = open(p.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("cannot open the file");
+    }
+    int ret = data ? fdatasync(fd) : fsync(fd);
+    trace::count(trace::fsyncs);
+    close(fd);
+    if (ret != 0) {
+        throw runtime_error("cannot sync the file");
+    }
+}
+
+Transaction::Transaction() {
+    if (active) {
+        throw runtime_error("a transaction is already in progress");
+    }
+    // init runs before there is a repository to lock
+    lockFd = open(".gitlet", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    while (lockFd >= 0 && flock(lockFd, LOCK_SH) != 0 && errno == EINTR) {
+    }
+    active = this;
+}
+
+Transaction::~Transaction() {
+    if (!done) {
+        std::error_code ec;
+        for (const auto &i : replaced) {
+            fs::remove(i.second, ec);
+        }
+        for (const auto &tmp : superseded) {
+            fs::remove(tmp, ec);
+        }
+        end();
+    }
+}
+
+void Transaction::end() {
+    if (journal.is_open()) {
+        journal.close();
+        std::error_code ec;
+        fs::remove(journalFile, ec);
+    }
+    if (lockFd >= 0) {
+        close(lockFd);
+        lockFd = -1;
+    }
+    done = true;
+    active = nullptr;
+}
+
+void Transaction::replace(const path &tmp, const path &file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!journal.is_open()) {
+        fs::create_directories(dir);
+        journalFile = dir / std::to_string(getpid());
+        journal.open(journalFile, std::ios::trunc);
+        if (!journal.is_open()) {
+            throw runtime_error("cannot open the journal");
+        }
+    }
+    // the journal only needs to reach the disk with the temp files, which
+    // are flushed at commit
+    journal << tmp.string() << '\n' << std::flush;
+    auto iter = positions.find(file);
+    if (iter == positions.end()) {
+        undo.push_back({replaced.size(), path()});
+        positions[file] = replaced.size();
+        replaced.push_back({file, tmp});
+    } else {
+        // other threads may be opening the temp file by its path still
+        undo.push_back({iter->second, replaced[iter->second].second});
+        superseded.push_back(replaced[iter->second].second);
+        replaced[iter->second].second = tmp;
+    }
+}
+
+void Transaction::remove(const path &file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    removed.push_back(file);
+}
+
+void Transaction::sync(const path &file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    synced.push_back(file);
+}
+
+path Transaction::pending(const path &file) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = positions.find(file);
+    return iter == positions.end() ? path() : replaced[iter->second].second;
+}
+
+void Transaction::commit(const path &last) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // the data of every temp file and file written in place, the fsyncs
+    // issued together so the disk can merge them
+    utils::parallelFor(replaced.size() + synced.size(), [this](size_t i) {
+        syncPath(i < replaced.size() ? replaced[i].second
+                                     : synced[i - replaced.size()],
+                 true);
+    });
+    if (!replaced.empty()) {
+        // then the renames, and one fsync of each directory they're in
+        std::set<path> dirs;
+        const std::pair<path, path> *deferred = nullptr;
+        for (const auto &i : replaced) {
+            dirs.insert(i.second.parent_path());
+            if (!last.empty() && i.first == last) {
+                deferred = &i;
+                continue;
+            }
+            fs::rename(i.second, i.first);
+            dirs.insert(i.first.parent_path());
+        }
+        for (const auto &d : dirs) {
+            syncPath(d.empty() ? "." : d, false);
+        }
+        if (deferred) {
+            fs::rename(deferred->second, deferred->first);
+            syncPath(last.parent_path(), false);
+        }
+    }
+    std::error_code ec;
+    for (const auto &tmp : superseded) {
+        fs::remove(tmp, ec);
+    }
+    for (const auto &file : removed) {
+        fs::remove(file, ec);
+    }
+    end();
+}
+
+void Transaction::savepoint() {
+    std::lock_guard<std::mutex> lock(mutex);
+    undo.clear();
+    removedMark = removed.size();
+}
+
+void Transaction::rollback() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code ec;
+    // newest first, so a new file is the last one replaced and a superseded
+    // temp file the last one listed
+    for (auto i = undo.rbegin(); i != undo.rend(); ++i) {
+        auto &entry = replaced[i->first];
+        fs::remove(entry.second, ec);
+        if (i->second.empty()) {
+            positions.erase(entry.first);
+            replaced.pop_back();
+        } else {
+            entry.second = i->second;
+            superseded.pop_back();
+        }
+    }
+    undo.clear();
+    removed.resize(removedMark);
+}
+
+void Transaction::lockExclusive() {
+    if (lockFd < 0) {
+        return;
+    }
+    trace::Scope scope("lock");
+    while (flock(lockFd, LOCK_EX) != 0) {
+        if (errno != EINTR) {
+            throw runtime_error("cannot lock the repository");
+        }
+    }
+}
+
+void Transaction::recover() {
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        return;
+    }
+    trace::Scope scope("scan");
+    for (auto &iter : fs::directory_iterator(dir)) {
+        string name = iter.path().filename();
+        if (name.empty() ||
+            name.find_first_not_of("0123456789") != string::npos) {
+            continue;
+        }
+        pid_t pid = std::stoi(name);
+        if (pid != getpid() && (kill(pid, 0) == 0 || errno != ESRCH)) {
+            continue;  // still running
+        }
+        std::ifstream is(iter.path());
+        string tmp;
+        while (std::getline(is, tmp)) {
+            fs::remove(tmp, ec);
+        }
+        fs::remove(iter.path(), ec);
+    }
+}
+
+void utils::replaceFile(const path &tmp, const path &file) {
+    if (Transaction *t = Transaction::current()) {
+        t->replace(tmp, file);
+    } else {
+        fs::rename(tmp, file);
+    }
+}
+
+void utils::removeFile(const path &file) {
+    if (Transaction *t = Transaction::current()) {
+        t->remove(file);
+    } else {
+        fs::remove(file);
+    }
+}
+
+void utils::syncFile(const path &file) {
+    if (Transaction *t = Transaction::current()) {
+        t->sync(file);
+    }
+}
+
+path utils::currentPath(const path &file) {
+    if (Transaction *t = Transaction::current()) {
+        path tmp = t->pending(file);
+        if (!tmp.empty()) {
+            return tmp;
+        }
+    }
+    return file;
+}
@@ -0,0 +1,91 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace gitlet {
+namespace utils {
+// A command runs as a transaction: the files it saves are written to temp
+// files next to them, which are only renamed into place by commit(), after
+// their data is flushed and followed by one fsync of each directory they
+// are in. The temp files are listed in a journal ".gitlet/journal/<pid>", so
+// the next command rolls back a process that died before committing. A
+// transaction holds a shared lock on ".gitlet" until it ends, which one that
+// removes objects other commands may rely on takes exclusively.
+class Transaction {
+  public:
+    // begin a transaction, it's the current one until it ends
+    Transaction();
+    // roll back unless committed
+    ~Transaction();
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+    // the transaction in progress, or nullptr
+    static Transaction *current() { return active; }
+    static std::filesystem::path getDir() { return dir; }
+    // make the temp file tmp replace file at commit
+    void replace(const std::filesystem::path &tmp,
+                 const std::filesystem::path &file);
+    // remove file at commit, once the replaced files are durable
+    void remove(const std::filesystem::path &file);
+    // flush file, written in place, at commit with the temp files
+    void sync(const std::filesystem::path &file);
+    // the temp file that will replace file, or an empty path
+    std::filesystem::path pending(const std::filesystem::path &file) const;
+    // make the replaced files durable and move them into place; if last is
+    // one of them, it's moved after all the others are durable
+    void commit(const std::filesystem::path &last = {});
+    // mark the point rollback() returns to
+    void savepoint();
+    // undo the replaces and removes since the last savepoint, the
+    // transaction goes on
+    void rollback();
+    // wait until the transactions of other processes end, and keep new ones
+    // from starting until this one ends
+    void lockExclusive();
+    // roll back the transactions of processes that died before committing
+    static void recover();
+
+  private:
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>>
+        replaced;  // files and their temp files, in the order replaced
+    std::map<std::filesystem::path, std::size_t> positions;  // in replaced
+    // temp files replaced by later ones, removed when the transaction ends
+    std::vector<std::filesystem::path> superseded;
+    std::vector<std::filesystem::path> removed;
+    std::vector<std::filesystem::path> synced;  // written in place
+    // the replaces since the savepoint: the position in replaced and the
+    // temp file replaced there, empty if the file was new
+    std::vector<std::pair<std::size_t, std::filesystem::path>> undo;
+    std::size_t removedMark = 0;  // size of removed at the savepoint
+    std::filesystem::path journalFile;
+    std::ofstream journal;
+    mutable std::mutex mutex;
+    int lockFd = -1;  // ".gitlet", if it exists
+    bool done = false;
+    static Transaction *active;
+    static const std::filesystem::path dir;
+
+    void end();
+};
+
+// move the finished temp file tmp to file, at the commit of the current
+// transaction if there is one, otherwise right away
+void replaceFile(const std::filesystem::path &tmp,
+                 const std::filesystem::path &file);
+// remove file, at the commit of the current transaction if there is one
+void removeFile(const std::filesystem::path &file);
+// flush file, appended to in place, at the commit of the current transaction
+// if there is one
+void syncFile(const std::filesystem::path &file);
+// the file holding what file will contain: the temp file replacing it in the
+// current transaction, or file itself
+std::filesystem::path currentPath(const std::filesystem::path &file);
+}  // namespace utils
+}  // namespace gitlet
+
+#endif /* ifndef JOURNAL_H */
@@ -0,0 +1,75 @@
+#ifndef LRU_H
+#define LRU_H
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace gitlet {
+namespace utils {
+struct CacheStats {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+};
+
+// bounded map that evicts the least recently used entry, safe to share
+// between threads
+template <typename K, typename V>
+class LRUCache {
+  public:
+    explicit LRUCache(std::size_t capacity) : capacity(capacity) {}
+    // copy the cached value of key into value, return false on a miss
+    bool get(const K &key, V &value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = index.find(key);
+        if (iter == index.end()) {
+            ++stats.misses;
+            return false;
+        }
+        ++stats.hits;
+        entries.splice(entries.begin(), entries, iter->second);
+        value = iter->second->second;
+        return true;
+    }
+    void put(const K &key, const V &value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = index.find(key);
+        if (iter != index.end()) {
+            iter->second->second = value;
+            entries.splice(entries.begin(), entries, iter->second);
+            return;
+        }
+        entries.emplace_front(key, value);
+        index[key] = entries.begin();
+        if (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+    }
+    CacheStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+  private:
+    std::size_t capacity;
+    std::list<std::pair<K, V>> entries;  // most recently used first
+    std::unordered_map<K, typename std::list<std::pair<K, V>>::iterator>
+        index;
+    CacheStats stats;
+    mutable std::mutex mutex;
+};
+}  // namespace utils
+}  // namespace gitlet
+
+#endif /* ifndef LRU_H */
@@ -1,14 +1,15 @@
 #include "gitletobj.h"
-#include "utils.h"
+#include "server.h"
+#include "trace.h"
 
 #include <filesystem>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
+namespace server = gitlet::server;
+namespace trace = gitlet::trace;
 namespace fs = std::filesystem;
-namespace utils = gitlet::utils;
 using fs::filesystem_error;
-using fs::path;
 using std::cout;
 using std::endl;
 using std::out_of_range;
@@ -21,22 +22,56 @@ using namespace gitlet::gitlet_obj;
 void parseArgs(int argc, char *argv[]) {
     if (argc < 2) {
         throw runtime_error("Please enter a command");
-    } else {
-        Gitlet git;
-        if (fs::exists(".gitlet")) {
-            path dir = git.getDir();
-            const auto &entry = fs::directory_iterator(dir);
-            string file = entry->path().filename();
-            utils::load(git, dir / file);
+    }
+    vector<string> args;
+    for (int i = 0; i != argc; ++i) {
+        args.push_back(argv[i]);
+    }
+    // "--trace" before the command traces it
+    bool traced = args[1] == "--trace";
+    if (traced) {
+        args.erase(args.begin() + 1);
+        if (args.size() < 2) {
+            throw runtime_error("Please enter a command");
         }
-        vector<string> args;
-        for (int i = 0; i != argc; ++i) {
-            args.push_back(argv[i]);
+    }
+    trace::startFromEnv(traced);
+    bool ok;
+    if (args[1] == "daemon") {
+        if (args.size() == 2) {
+            server::serve();
+        } else if (args.size() == 3 && args[2] == "stop") {
+            if (!server::request(args, cout, ok)) {
+                throw runtime_error("No daemon is running");
+            }
+        } else {
+            throw runtime_error("command is illegal");
         }
-        CommandExecutor ce;
-        ce.execCommand(git, args);
-        utils::save(git, git.getDir() / git.getID());
+        return;
+    }
+    if (args[1] == "batch") {
+        if (args.size() == 2) {
+            server::batch(args[0], std::cin, '\n', std::cerr);
+        } else if (args.size() == 3 && args[2] == "-z") {
+            server::batch(args[0], std::cin, '\0', std::cerr);
+        } else {
+            throw runtime_error("command is illegal");
+        }
+        return;
+    }
+    // the daemon runs the command if there is one, otherwise it's run here;
+    // a command traced with --trace is run here, so all its phases are
+    if (traced && server::running()) {
+        std::cerr << "--trace runs the command here rather than in the daemon"
+                  << endl;
+    } else if (server::request(args, cout, ok)) {
+        return;
+    }
+    Gitlet git;
+    if (fs::exists(".gitlet")) {
+        server::load(git);
     }
+    server::execute(git, args);
 }
 
 int main(int argc, char *argv[]) {
@@ -47,5 +82,6 @@ int main(int argc, char *argv[]) {
     } catch (const runtime_error &e3) {
         cout << e3.what();
     }
+    trace::stop();
     return 0;
 }
@@ -0,0 +1,302 @@
+#include "pack.h"
+
+#include "journal.h"
+#include "utils.h"
+
+#include <cryptopp/sha.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+namespace fs = std::filesystem;
+namespace pack = gitlet::pack;
+namespace utils = gitlet::utils;
+using fs::path;
+using pack::Pack;
+using std::ofstream;
+using std::runtime_error;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+static const char packMagic[] = "GPAK";
+static const char idxMagic[] = "GIDX";
+static const uint32_t packVersion = 1;
+static const size_t headerSize = 12;  // magic, version, count
+static const size_t idSize = 20;
+static const size_t entrySize = idSize + 8 + 8;  // id, offset, length
+static const size_t digestSize = 20;
+
+static string header(const char *magic, size_t count) {
+    string s(magic, 4);
+    utils::putU32(s, packVersion);
+    utils::putU32(s, count);
+    return s;
+}
+
+static string digestOf(const unsigned char *data, size_t size) {
+    CryptoPP::SHA1 hash;
+    string digest(hash.DigestSize(), '\0');
+    hash.Update(data, size);
+    hash.Final((CryptoPP::byte *)&digest[0]);
+    return digest;
+}
+
+Pack::Pack(const path &idxFile) {
+    path file = idxFile;
+    idx.reset(new utils::MappedFile(file));
+    packFile.reset(new utils::MappedFile(file.replace_extension(".pack")));
+    const unsigned char *idxData = idx->data();
+    const unsigned char *packData = packFile->data();
+    size_t idxSize = idx->size();
+    size_t packSize = packFile->size();
+    bool ok = idxSize >= headerSize && packSize >= headerSize + digestSize &&
+              memcmp(idxData, idxMagic, 4) == 0 &&
+              memcmp(packData, packMagic, 4) == 0 &&
+              utils::getU32(idxData + 4) == packVersion &&
+              utils::getU32(packData + 4) == packVersion;
+    if (ok) {
+        count = utils::getU32(idxData + 8);
+        ok = count == utils::getU32(packData + 8) &&
+             idxSize == headerSize + count * entrySize + 2 * digestSize &&
+             memcmp(idxData + idxSize - 2 * digestSize,
+                    packData + packSize - digestSize, digestSize) == 0;
+    }
+    if (!ok) {
+        throw runtime_error("corrupt pack file");
+    }
+}
+
+Pack::~Pack() = default;
+
+const unsigned char *Pack::entry(size_t i) const {
+    return idx->data() + headerSize + i * entrySize;
+}
+
+bool Pack::find(const string &id, string_view &data) const {
+    string key;
+    if (id.size() != 2 * idSize || !utils::fromHex(id, key)) {
+        return false;
+    }
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(entry(mid), key.data(), idSize);
+        if (cmp == 0) {
+            uint64_t offset = utils::getU64(entry(mid) + idSize);
+            uint64_t length = utils::getU64(entry(mid) + idSize + 8);
+            if (offset + length > packFile->size() - digestSize) {
+                throw runtime_error("corrupt pack file");
+            }
+            data = string_view(
+                reinterpret_cast<const char *>(packFile->data()) + offset,
+                length);
+            return true;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+void Pack::matchPrefix(const string &prefix, vector<string> &ids) const {
+    string key;
+    if (prefix.size() > 2 * idSize ||
+        !utils::fromHex(prefix + string(2 * idSize - prefix.size(), '0'),
+                        key)) {
+        return;
+    }
+    // the first entry not less than the prefix padded with zeros
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp(entry(mid), key.data(), idSize) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; lo != count; ++lo) {
+        string id = utils::toHex(
+            string_view(reinterpret_cast<const char *>(entry(lo)), idSize));
+        if (id.compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        ids.push_back(id);
+    }
+}
+
+bool Pack::verify() const {
+    for (const utils::MappedFile *file : {idx.get(), packFile.get()}) {
+        size_t body = file->size() - digestSize;
+        if (digestOf(file->data(), body) !=
+            string(reinterpret_cast<const char *>(file->data()) + body,
+                   digestSize)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+// opened packs of one object directory, reopened whenever the pack directory
+// changes (a repack, or the repository was removed and created again)
+struct PackSet {
+    dev_t dev = 0;
+    ino_t ino = 0;
+    struct timespec mtime = {0, 0};
+    vector<unique_ptr<Pack>> packs;
+};
+}  // namespace
+
+// guards the opened packs, objects are looked up from worker threads
+static std::mutex packsMutex;
+
+static vector<unique_ptr<Pack>> &packsOf(const path &dir) {
+    static unordered_map<string, PackSet> sets;
+    PackSet &set = sets[dir.string()];
+    path packDir = dir / "pack";
+    struct stat st;
+    if (stat(packDir.c_str(), &st) != 0) {
+        set = PackSet();
+        return set.packs;
+    }
+    if (set.dev == st.st_dev && set.ino == st.st_ino &&
+        set.mtime.tv_sec == st.st_mtim.tv_sec &&
+        set.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        return set.packs;
+    }
+    set = PackSet();
+    set.dev = st.st_dev;
+    set.ino = st.st_ino;
+    set.mtime = st.st_mtim;
+    for (auto &iter : fs::directory_iterator(packDir)) {
+        if (iter.path().extension() == ".idx") {
+            set.packs.emplace_back(new Pack(iter.path()));
+        }
+    }
+    return set.packs;
+}
+
+bool pack::find(const path &dir, const string &id, string_view &data) {
+    std::lock_guard<std::mutex> lock(packsMutex);
+    for (const auto &p : packsOf(dir)) {
+        if (p->find(id, data)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+vector<string> pack::matchPrefix(const path &dir, const string &prefix) {
+    std::lock_guard<std::mutex> lock(packsMutex);
+    vector<string> ids;
+    for (const auto &p : packsOf(dir)) {
+        p->matchPrefix(prefix, ids);
+    }
+    return ids;
+}
+
+bool pack::verify(const path &dir) {
+    std::lock_guard<std::mutex> lock(packsMutex);
+    for (const auto &p : packsOf(dir)) {
+        if (!p->verify()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ids and files of the loose objects of dir, flat or sharded
+static vector<std::pair<string, path>> looseObjects(const path &dir) {
+    vector<std::pair<string, path>> loose;
+    string raw;
+    for (auto &iter : fs::directory_iterator(dir)) {
+        string name = iter.path().filename();
+        if (iter.is_regular_file() && name.size() == 2 * idSize &&
+            utils::fromHex(name, raw)) {
+            loose.push_back({name, iter.path()});
+        } else if (iter.is_directory() && name.size() == 2 &&
+                   utils::fromHex(name, raw)) {
+            for (auto &obj : fs::directory_iterator(iter.path())) {
+                string id = name + obj.path().filename().string();
+                if (obj.is_regular_file() && id.size() == 2 * idSize &&
+                    utils::fromHex(id, raw)) {
+                    loose.push_back({id, obj.path()});
+                }
+            }
+        }
+    }
+    sort(loose.begin(), loose.end());
+    // an object both flat and sharded by an interrupted migration is packed
+    // once
+    auto same = [](const auto &a, const auto &b) { return a.first == b.first; };
+    loose.erase(unique(loose.begin(), loose.end(), same), loose.end());
+    return loose;
+}
+
+size_t pack::repack(const path &dir) {
+    auto loose = looseObjects(dir);
+    if (loose.empty()) {
+        return 0;
+    }
+    path packDir = dir / "pack";
+    fs::create_directories(packDir);
+    path tmpPack = utils::tempFile(packDir);
+    path tmpIdx = utils::tempFile(packDir);
+    ofstream packOut(tmpPack, std::ios::binary);
+    ofstream idxOut(tmpIdx, std::ios::binary);
+    if (!packOut.is_open() || !idxOut.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    CryptoPP::SHA1 packHash, idxHash;
+    auto emit = [](ofstream &os, CryptoPP::SHA1 &hash, const string &s) {
+        os.write(s.data(), s.size());
+        hash.Update((const CryptoPP::byte *)s.data(), s.size());
+    };
+    emit(packOut, packHash, header(packMagic, loose.size()));
+    emit(idxOut, idxHash, header(idxMagic, loose.size()));
+    uint64_t offset = headerSize;
+    for (const auto &[id, file] : loose) {
+        string content = utils::readFile(file);
+        emit(packOut, packHash, content);
+        string e;
+        utils::fromHex(id, e);
+        utils::putU64(e, offset);
+        utils::putU64(e, content.size());
+        emit(idxOut, idxHash, e);
+        offset += content.size();
+    }
+    string packDigest(packHash.DigestSize(), '\0');
+    packHash.Final((CryptoPP::byte *)&packDigest[0]);
+    packOut.write(packDigest.data(), packDigest.size());
+    emit(idxOut, idxHash, packDigest);
+    string idxDigest(idxHash.DigestSize(), '\0');
+    idxHash.Final((CryptoPP::byte *)&idxDigest[0]);
+    idxOut.write(idxDigest.data(), idxDigest.size());
+    packOut.close();
+    idxOut.close();
+    if (!packOut || !idxOut) {
+        fs::remove(tmpPack);
+        fs::remove(tmpIdx);
+        throw runtime_error("cannot write the pack file");
+    }
+    // the index is renamed last, a pack without index is never read
+    string name = "pack-" + utils::toHex(packDigest);
+    utils::replaceFile(tmpPack, packDir / (name + ".pack"));
+    utils::replaceFile(tmpIdx, packDir / (name + ".idx"));
+    for (const auto &[id, file] : loose) {
+        utils::removeFile(file);
+    }
+    return loose.size();
+}
@@ -0,0 +1,62 @@
+#ifndef PACK_H
+#define PACK_H
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitlet {
+namespace utils {
+class MappedFile;
+}
+namespace pack {
+// A pack stores many serialized objects of one object directory in two files
+// under "<dir>/pack":
+//   pack-<checksum>.pack: header, the objects back to back, sha1 trailer
+//   pack-<checksum>.idx:  header, entries sorted by id (binary id, offset,
+//                         length), pack checksum, sha1 trailer
+// Both files are memory-mapped, so a lookup is a binary search in the index
+// plus a view into the pack.
+class Pack {
+  public:
+    explicit Pack(const std::filesystem::path &idxFile);
+    ~Pack();
+    Pack(const Pack &) = delete;
+    Pack &operator=(const Pack &) = delete;
+    // find the serialized bytes of the object with the given id, return false
+    // if it's not in this pack
+    bool find(const std::string &id, std::string_view &data) const;
+    // append ids of this pack starting with the given prefix to ids
+    void matchPrefix(const std::string &prefix,
+                     std::vector<std::string> &ids) const;
+    // recompute the checksums of both files, return false on mismatch
+    bool verify() const;
+    std::size_t size() const { return count; }
+
+  private:
+    std::unique_ptr<utils::MappedFile> idx;
+    std::unique_ptr<utils::MappedFile> packFile;
+    std::size_t count = 0;
+
+    const unsigned char *entry(std::size_t i) const;
+};
+
+// find the serialized bytes of the object with the given id in the packs of
+// an object directory, return false if no pack has it
+bool find(const std::filesystem::path &dir, const std::string &id,
+          std::string_view &data);
+// ids of packed objects in dir starting with the given prefix
+std::vector<std::string> matchPrefix(const std::filesystem::path &dir,
+                                     const std::string &prefix);
+// move loose objects of dir into a new pack, return the number of objects
+// packed
+std::size_t repack(const std::filesystem::path &dir);
+// verify checksums of every pack in dir
+bool verify(const std::filesystem::path &dir);
+}  // namespace pack
+}  // namespace gitlet
+
+#endif /* ifndef PACK_H */
@@ -0,0 +1,437 @@
+#include "server.h"
+
+#include "codec.h"
+#include "journal.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+namespace server = gitlet::server;
+namespace codec = gitlet::codec;
+namespace fs = std::filesystem;
+namespace utils = gitlet::utils;
+namespace trace = gitlet::trace;
+using fs::path;
+using std::runtime_error;
+using std::string;
+using std::vector;
+using namespace gitlet::gitlet_obj;
+
+// longest argument or output accepted, a bound on what a broken peer makes
+// us allocate
+static const size_t maxString = size_t(1) << 30;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) { stopping = 1; }
+
+path server::getSocket() { return ".gitlet/daemon.sock"; }
+
+void server::load(Gitlet &git) {
+    // roll back commands that died halfway
+    utils::Transaction::recover();
+    trace::Scope scope("state load");
+    utils::loadHashAlgorithm();
+    path state = Gitlet::getFile();
+    std::error_code ec;
+    if (!fs::exists(state, ec)) {
+        // a repository from before the state had a known name keeps it in
+        // the file named by its id, which is renamed once
+        for (const auto &entry :
+             fs::directory_iterator(Gitlet::getDir(), ec)) {
+            string file = entry.path().filename();
+            if (file.compare(0, 4, "tmp-") != 0) {
+                fs::rename(entry.path(), state, ec);
+                break;
+            }
+        }
+    }
+    if (fs::exists(state, ec)) {
+        utils::load(git, state);
+    }
+    git.markClean();
+}
+
+static CommandExecutor &executor() {
+    static CommandExecutor ce;
+    return ce;
+}
+
+// save the state in the transaction if a command changed it, and commit
+static void commit(Gitlet &git, utils::Transaction &tx) {
+    if (git.isDirty()) {
+        utils::save(git, Gitlet::getFile());
+        tx.commit(Gitlet::getFile());
+        git.markClean();
+    } else {
+        tx.commit();
+    }
+}
+
+void server::execute(Gitlet &git, const vector<string> &args) {
+    if (args.size() >= 2 && executor().isReadOnly(args[1])) {
+        executor().execCommand(git, args);
+        return;
+    }
+    // everything the command saves becomes visible at once, the state last,
+    // or not at all
+    utils::Transaction tx;
+    codec::loadSettings();
+    executor().execCommand(git, args);
+    commit(git, tx);
+}
+
+static sockaddr_un address() {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    string file = server::getSocket();
+    if (file.size() >= sizeof(addr.sun_path)) {
+        throw runtime_error("the socket path is too long");
+    }
+    memcpy(addr.sun_path, file.c_str(), file.size() + 1);
+    return addr;
+}
+
+// connect to the daemon, return -1 if none is listening
+static int connectDaemon() {
+    sockaddr_un addr = address();
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw runtime_error("cannot create the socket");
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool readFull(int fd, char *p, size_t n) {
+    while (n != 0) {
+        ssize_t got = read(fd, p, n);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got <= 0) {
+            return false;
+        }
+        p += got;
+        n -= got;
+    }
+    return true;
+}
+
+static bool writeFull(int fd, const string &data) {
+    const char *p = data.data();
+    size_t n = data.size();
+    while (n != 0) {
+        ssize_t put = send(fd, p, n, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        } else if (put < 0) {
+            return false;
+        }
+        p += put;
+        n -= put;
+    }
+    return true;
+}
+
+static bool readU32(int fd, uint32_t &v) {
+    unsigned char buf[4];
+    if (!readFull(fd, reinterpret_cast<char *>(buf), sizeof(buf))) {
+        return false;
+    }
+    v = utils::getU32(buf);
+    return true;
+}
+
+static bool readString(int fd, string &s) {
+    uint32_t size;
+    if (!readU32(fd, size) || size > maxString) {
+        return false;
+    }
+    s.resize(size);
+    return readFull(fd, s.data(), size);
+}
+
+static void putString(string &out, const string &s) {
+    utils::putU32(out, s.size());
+    out.append(s);
+}
+
+// identity of the state file, to tell whether another process changed it
+struct Stamp {
+    ino_t ino = 0;
+    off_t size = 0;
+    timespec mtime = {};
+
+    bool operator==(const Stamp &other) const {
+        return ino == other.ino && size == other.size &&
+               mtime.tv_sec == other.mtime.tv_sec &&
+               mtime.tv_nsec == other.mtime.tv_nsec;
+    }
+};
+
+static Stamp stampOf(const path &file) {
+    Stamp s;
+    struct stat st;
+    trace::count(trace::filesStated);
+    if (stat(file.c_str(), &st) == 0) {
+        s.ino = st.st_ino;
+        s.size = st.st_size;
+        s.mtime = st.st_mtim;
+    }
+    return s;
+}
+
+// run a request of a client on git, return the response
+static string respond(Gitlet &git, const vector<string> &args) {
+    std::ostringstream output;
+    auto *old = std::cout.rdbuf(output.rdbuf());
+    bool ok = true;
+    try {
+        server::execute(git, args);
+    } catch (const std::exception &e) {
+        output << e.what();
+        ok = false;
+    }
+    std::cout.rdbuf(old);
+    if (!ok) {
+        // the transaction was rolled back, so is the state
+        git = Gitlet();
+        server::load(git);
+    }
+    string response;
+    utils::putU32(response, ok ? 0 : 1);
+    putString(response, output.str());
+    return response;
+}
+
+void server::serve() {
+    if (!fs::exists(".gitlet")) {
+        throw runtime_error("Not in an initialized Gitlet directory");
+    }
+    Gitlet git;
+    load(git);
+    path state = Gitlet::getFile();
+    Stamp loaded = stampOf(state);
+
+    sockaddr_un addr = address();
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw runtime_error("cannot create the socket");
+    }
+    auto *sa = reinterpret_cast<sockaddr *>(&addr);
+    if (bind(fd, sa, sizeof(addr)) != 0 && errno == EADDRINUSE) {
+        // the socket of a daemon that died is replaced
+        int other = connectDaemon();
+        if (other >= 0) {
+            close(other);
+            close(fd);
+            throw runtime_error("A daemon already serves this repository");
+        }
+        unlink(addr.sun_path);
+        if (bind(fd, sa, sizeof(addr)) != 0) {
+            close(fd);
+            throw runtime_error("cannot bind the socket");
+        }
+    }
+    if (listen(fd, 64) != 0) {
+        close(fd);
+        unlink(addr.sun_path);
+        throw runtime_error("cannot listen on the socket");
+    }
+    // signals interrupt accept() instead of restarting it
+    struct sigaction action = {}, oldInt, oldTerm;
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, &oldInt);
+    sigaction(SIGTERM, &action, &oldTerm);
+    stopping = 0;
+    while (!stopping) {
+        int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            continue;
+        }
+        uint32_t argc;
+        vector<string> args;
+        bool ok = readU32(client, argc) && argc >= 2 && argc <= 1 << 20;
+        for (uint32_t i = 0; ok && i != argc; ++i) {
+            args.emplace_back();
+            ok = readString(client, args.back());
+        }
+        if (!ok) {
+            close(client);
+            continue;
+        }
+        string response;
+        if (args.size() == 3 && args[1] == "daemon" && args[2] == "stop") {
+            stopping = 1;
+            utils::putU32(response, 0);
+            putString(response, "");
+        } else {
+            // reload the state if a command ran without the daemon
+            if (!(stampOf(state) == loaded)) {
+                git = Gitlet();
+                load(git);
+            }
+            response = respond(git, args);
+            loaded = stampOf(state);
+        }
+        {
+            trace::Scope scope("output");
+            writeFull(client, response);
+        }
+        close(client);
+        // each request is traced on its own
+        trace::flush();
+    }
+    sigaction(SIGINT, &oldInt, nullptr);
+    sigaction(SIGTERM, &oldTerm, nullptr);
+    close(fd);
+    unlink(addr.sun_path);
+}
+
+// split a batch command into args, return false if a quote isn't closed
+static bool split(const string &command, vector<string> &args) {
+    string arg;
+    bool inArg = false, quoted = false;
+    for (size_t i = 0; i != command.size(); ++i) {
+        char c = command[i];
+        if (quoted) {
+            if (c == '"') {
+                quoted = false;
+            } else if (c == '\\' && i + 1 != command.size() &&
+                       (command[i + 1] == '"' || command[i + 1] == '\\')) {
+                arg.push_back(command[++i]);
+            } else {
+                arg.push_back(c);
+            }
+        } else if (c == '"') {
+            quoted = inArg = true;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            if (inArg) {
+                args.push_back(std::move(arg));
+                arg.clear();
+                inArg = false;
+            }
+        } else {
+            arg.push_back(c);
+            inArg = true;
+        }
+    }
+    if (inArg) {
+        args.push_back(std::move(arg));
+    }
+    return !quoted;
+}
+
+size_t server::batch(const string &program, std::istream &in, char delim,
+                     std::ostream &err) {
+    bool served = running(), ok;
+    Gitlet git;
+    if (!served && fs::exists(".gitlet")) {
+        load(git);
+    }
+    std::unique_ptr<utils::Transaction> tx;
+    if (!served) {
+        tx.reset(new utils::Transaction);
+    }
+    auto checkpoint = [&] {
+        if (tx) {
+            commit(git, *tx);
+            tx.reset(new utils::Transaction);
+        }
+    };
+    size_t failed = 0;
+    string command;
+    for (size_t number = 1; std::getline(in, command, delim); ++number) {
+        vector<string> args = {program};
+        // a command that fails is undone, like one the daemon runs, while
+        // the commands before it stay in the transaction
+        Gitlet saved;
+        if (tx) {
+            tx->savepoint();
+            saved = git;
+        }
+        try {
+            if (!split(command, args)) {
+                throw runtime_error("a quote isn't closed");
+            } else if (args.size() == 1 || args[1][0] == '#') {
+                continue;
+            } else if (args.size() == 2 && args[1] == "checkpoint") {
+                checkpoint();
+            } else if (!served) {
+                codec::loadSettings();
+                executor().execCommand(git, args);
+            } else {
+                std::ostringstream out;
+                if (!request(args, out, ok)) {
+                    throw runtime_error("the daemon stopped");
+                } else if (!ok) {
+                    throw runtime_error(out.str());
+                }
+                std::cout << out.str();
+            }
+        } catch (const std::exception &e) {
+            err << "command " << number << ": " << e.what() << std::endl;
+            ++failed;
+            if (tx) {
+                tx->rollback();
+                git = std::move(saved);
+            }
+        }
+    }
+    checkpoint();
+    return failed;
+}
+
+bool server::running() {
+    std::error_code ec;
+    if (!fs::exists(getSocket(), ec)) {
+        return false;
+    }
+    int fd = connectDaemon();
+    if (fd >= 0) {
+        close(fd);
+    }
+    return fd >= 0;
+}
+
+bool server::request(const vector<string> &args, std::ostream &out,
+                     bool &ok) {
+    std::error_code ec;
+    if (!fs::exists(getSocket(), ec)) {
+        return false;
+    }
+    int fd = connectDaemon();
+    if (fd < 0) {
+        return false;
+    }
+    string req;
+    utils::putU32(req, args.size());
+    for (const auto &arg : args) {
+        putString(req, arg);
+    }
+    uint32_t status;
+    string output;
+    if (!writeFull(fd, req) || !readU32(fd, status) ||
+        !readString(fd, output)) {
+        close(fd);
+        throw runtime_error("the daemon didn't answer");
+    }
+    close(fd);
+    out << output;
+    ok = status == 0;
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include <cstddef>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "gitletobj.h"
+
+namespace gitlet {
+namespace server {
+// A daemon serves the commands of the repository in its directory over the
+// Unix socket ".gitlet/daemon.sock", keeping the repository state and the
+// caches of commits, blobs and the index in memory between commands. The
+// state is reloaded when another process changed it.
+//   request:  number of arguments, then each argument
+//   response: status, 0 if the command succeeded, then its output
+// Numbers are u32 and strings are their size (u32) followed by the bytes.
+std::filesystem::path getSocket();
+// load the state of the repository in the current directory into git
+void load(gitlet_obj::Gitlet &git);
+// run a command as one transaction, its changes and the state in git are
+// saved together or not at all
+void execute(gitlet_obj::Gitlet &git, const std::vector<std::string> &args);
+// run the commands read from in, each ended by delim, against one state:
+// a command is split into arguments at blanks, double quotes group blanks
+// into an argument and \" or \\ escape inside them; blank commands and
+// those starting with '#' are skipped. The state is saved at the end and at
+// each "checkpoint" command, and a failing command is reported to err
+// without stopping the others. Commands go to the daemon if one is running.
+// Return the number of commands that failed.
+std::size_t batch(const std::string &program, std::istream &in, char delim,
+                  std::ostream &err);
+// serve commands until "daemon stop" or a signal to stop, if a daemon already
+// serves the repository or the socket cannot be bound, throw a runtime_error
+void serve();
+// whether a daemon serves the current directory
+bool running();
+// run a command by the daemon of the current directory, writing its output
+// to out, return false if no daemon is running; ok tells whether the command
+// succeeded
+bool request(const std::vector<std::string> &args, std::ostream &out,
+             bool &ok);
+}  // namespace server
+}  // namespace gitlet
+
+#endif /* ifndef SERVER_H */
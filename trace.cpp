@@ -0,0 +1,175 @@
+#include "trace.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+namespace trace = gitlet::trace;
+using std::runtime_error;
+using std::string;
+using std::uint64_t;
+using Clock = std::chrono::steady_clock;
+
+#ifndef GITLET_NO_TRACE
+bool trace::on = false;
+#endif
+std::atomic<uint64_t> trace::counters[counterCount];
+
+namespace {
+struct Event {
+    const char *name;
+    const char *category;
+    uint64_t ts;   // microseconds since tracing started
+    uint64_t dur;  // microseconds
+    unsigned tid;
+};
+
+const char *counterNames[trace::counterCount] = {
+    "objects_read", "objects_written", "bytes_hashed", "files_stated",
+    "fsyncs"};
+
+std::mutex mutex;
+std::vector<Event> events;
+Clock::time_point origin;
+std::ofstream file;
+std::ostream *out = nullptr;
+bool chrome = false;
+bool opened = false;  // the Chrome array was begun
+
+unsigned threadID() {
+    static std::atomic<unsigned> next{1};
+    thread_local unsigned id = next++;
+    return id;
+}
+
+uint64_t micros(Clock::time_point t) {
+    if (t < origin) {
+        return 0;  // begun before tracing was restarted
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - origin)
+        .count();
+}
+
+// name as a JSON string
+string quote(const char *name) {
+    string s = "\"";
+    for (const char *p = name; *p; ++p) {
+        if (*p == '"' || *p == '\\') {
+            s.push_back('\\');
+            s.push_back(*p);
+        } else if ((unsigned char)*p < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", *p);
+            s.append(buf);
+        } else {
+            s.push_back(*p);
+        }
+    }
+    return s + "\"";
+}
+}  // namespace
+
+void trace::start(const string &name, bool chromeFormat) {
+#ifndef GITLET_NO_TRACE
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file.is_open()) {
+        file.close();
+    }
+    if (name == "-") {
+        out = &std::cerr;
+    } else {
+        // JSON lines of several runs add up, a Chrome trace is one array
+        file.open(name, chromeFormat ? std::ios::trunc : std::ios::app);
+        if (!file.is_open()) {
+            throw runtime_error("cannot open the trace file");
+        }
+        out = &file;
+    }
+    chrome = chromeFormat;
+    opened = false;
+    events.clear();
+    for (auto &c : counters) {
+        c = 0;
+    }
+    origin = Clock::now();
+    on = true;
+#endif
+}
+
+void trace::startFromEnv(bool flag) {
+    const char *name = getenv("GITLET_TRACE");
+    if (!flag && (!name || !*name)) {
+        return;
+    }
+    const char *format = getenv("GITLET_TRACE_FORMAT");
+    start(name && *name ? name : "-", format && string(format) == "chrome");
+}
+
+void trace::flush() {
+    if (!enabled()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t now = micros(Clock::now());
+    int pid = getpid();
+    std::ostream &os = *out;
+    if (chrome && !opened) {
+        // the closing bracket is optional, so later flushes can append
+        os << "[\n";
+        opened = true;
+    }
+    for (const auto &e : events) {
+        if (chrome) {
+            os << "{\"name\":" << quote(e.name)
+               << ",\"cat\":" << quote(e.category)
+               << ",\"ph\":\"X\",\"ts\":" << e.ts << ",\"dur\":" << e.dur
+               << ",\"pid\":" << pid << ",\"tid\":" << e.tid << "},\n";
+        } else {
+            os << "{\"type\":\"scope\",\"name\":" << quote(e.name)
+               << ",\"cat\":" << quote(e.category) << ",\"ts\":" << e.ts
+               << ",\"dur\":" << e.dur << ",\"pid\":" << pid
+               << ",\"tid\":" << e.tid << "}\n";
+        }
+    }
+    events.clear();
+    if (chrome) {
+        os << "{\"name\":\"counters\",\"ph\":\"C\",\"ts\":" << now
+           << ",\"pid\":" << pid << ",\"args\":{";
+    } else {
+        os << "{\"type\":\"counters\",\"ts\":" << now << ",\"pid\":" << pid;
+    }
+    for (int i = 0; i != counterCount; ++i) {
+        os << (chrome && i == 0 ? "\"" : ",\"") << counterNames[i]
+           << "\":" << counters[i].exchange(0);
+    }
+    os << (chrome ? "}},\n" : "}\n") << std::flush;
+}
+
+void trace::stop() {
+    flush();
+#ifndef GITLET_NO_TRACE
+    std::lock_guard<std::mutex> lock(mutex);
+    on = false;
+    if (file.is_open()) {
+        file.close();
+    }
+    out = nullptr;
+#endif
+}
+
+void trace::Scope::record(const char *name, const char *category,
+                          Clock::time_point begin) {
+    Clock::time_point end = Clock::now();
+    Event e{name, category, micros(begin),
+            uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                         end - begin)
+                         .count()),
+            threadID()};
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(e);
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace gitlet {
+namespace trace {
+// Tracing of where a command spends its time. Scopes time the phases of a
+// command and counters add up the work done, both are only recorded once
+// tracing is started, by the environment variable GITLET_TRACE naming the
+// output file ("-" for stderr) or by the --trace flag. A daemon is only
+// traced by its own environment, so --trace runs the command in-process even
+// if a daemon is running. Each flush() writes the recorded scopes and the
+// counters as JSON lines, or as Chrome trace-event format if
+// GITLET_TRACE_FORMAT is "chrome". Compiled with
+// GITLET_NO_TRACE, tracing is never on and compiles down to nothing.
+enum Counter {
+    objectsRead,
+    objectsWritten,
+    bytesHashed,
+    filesStated,
+    fsyncs,
+    counterCount
+};
+
+#ifdef GITLET_NO_TRACE
+constexpr bool enabled() { return false; }
+#else
+extern bool on;
+inline bool enabled() { return on; }
+#endif
+
+extern std::atomic<std::uint64_t> counters[counterCount];
+
+// record from now on into file, "-" for stderr, in Chrome trace-event format
+// if chrome; if cannot open the file, throw a runtime_error
+void start(const std::string &file, bool chrome);
+// start() as told by GITLET_TRACE and GITLET_TRACE_FORMAT, if set; if flag,
+// the --trace flag was given and file defaults to stderr
+void startFromEnv(bool flag);
+// write the scopes and counters recorded so far and reset them
+void flush();
+// flush() and stop recording
+void stop();
+
+inline void count(Counter c, std::uint64_t n = 1) {
+    if (enabled()) {
+        counters[c].fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+// times the code from its construction to its destruction, name and category
+// must stay valid until the next flush()
+class Scope {
+  public:
+    explicit Scope(const char *name, const char *category = "phase")
+        : name(name), category(category), active(enabled()) {
+        if (active) {
+            begin = std::chrono::steady_clock::now();
+        }
+    }
+    ~Scope() {
+        if (active) {
+            record(name, category, begin);
+        }
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    const char *name;
+    const char *category;
+    bool active;
+    std::chrono::steady_clock::time_point begin;
+
+    static void record(const char *name, const char *category,
+                       std::chrono::steady_clock::time_point begin);
+};
+}  // namespace trace
+}  // namespace gitlet
+
+#endif /* ifndef TRACE_H */
@@ -1,11 +1,30 @@
+#include "bitmap.h"
+#include "chunk.h"
+#include "codec.h"
+#include "commitgraph.h"
+#include "config.h"
+#include "delta.h"
 #include "gitletobj.h"
+#include "index.h"
+#include "journal.h"
+#include "server.h"
+#include "trace.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <stdexcept>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 namespace utils = gitlet::utils;
 namespace fs = std::filesystem;
 using std::cout;
@@ -36,11 +55,15 @@ static CommandExecutor ce;
         assert(exceptionThrown);                                                \
     }
 
-// clear .gitlet directory, return the number of files or directory deleted
+// clear .gitlet directory, return the number of files deleted; directories
+// aren't counted since the shards of loose objects depend on their ids
 static uintmax_t clearGitlet() {
     uintmax_t n = 0;
     if (fs::exists(".gitlet")) {
-        n = fs::remove_all(".gitlet");
+        for (auto &iter : fs::recursive_directory_iterator(".gitlet")) {
+            n += iter.is_regular_file();
+        }
+        fs::remove_all(".gitlet");
     }
     return n;
 }
@@ -63,14 +86,14 @@ static void testInit() {
     assert(fs::exists(".gitlet/commit"));
     assert(fs::exists(".gitlet/blob"));
     string head = test.getHead();
-    assert(fs::exists(Commit::getDir() / head));
+    assert(fs::exists(utils::objectPath(Commit::getDir(), head)));
     // there is a ".gitlet"
     string expected = "A Gitlet version-control system, already exists in the "
                       "current directory";
     vector<string> args{"./unittest", "init"};
     ASSERT_THROW(ce.execCommand(test, args), runtime_error, expected);
     // check number of files or directories
-    // assert(clearGitlet() == 5);  // 4 directories, 1 commit
+    // assert(clearGitlet() == 1);  // 1 commit
     cout << "test init successfully" << endl;
 }
 
@@ -90,7 +113,7 @@ static void testAdd01() {
     // deserialize the blob and compare the content
     string blobID = test.getStagedBlobID(testFile);
     assert(!blobID.empty());
-    fs::path file = Blob::getDir() / blobID;
+    fs::path file = utils::objectPath(Blob::getDir(), blobID);
     assert(fs::exists(file));
     Blob testBlob;
     utils::load(testBlob, file);
@@ -100,14 +123,14 @@ static void testAdd01() {
     ce.execCommand(test, args);
     string newBlobID = test.getStagedBlobID(testFile);
     assert(!newBlobID.empty());
-    fs::path newFile = Blob::getDir() / newBlobID;
+    fs::path newFile = utils::objectPath(Blob::getDir(), newBlobID);
     assert(file != newFile);  // file names aren't equal
-    assert(!fs::exists(file));
+    assert(fs::exists(file));  // left for gc
     assert(fs::exists(newFile));
     utils::load(testBlob, newFile);
     assert(testBlob.getContent() == utils::readFile(testFile));
     // tear down
-    assert(clearGitlet() == 6);  // 4 directories, 1 commit, 1 blob
+    assert(clearGitlet() == 3);  // 1 commit, 2 blobs
     assert(fs::remove(testFile));
     cout << "test add 01 successfully" << endl;
 }
@@ -126,10 +149,10 @@ static void testAdd02() {
     utils::writeFile(testFile, content);
     Blob blob(content);
     string blobID = blob.getID();
-    utils::save(blob, Blob::getDir() / blobID);
+    utils::saveObject(blob, Blob::getDir(), blobID);
     commitBlob.insert({testFile, blobID});
     Commit c(log, commitBlob, parent);
-    utils::save(c, Commit::getDir() / c.getID());
+    c.save();
     test.setHead(c.getID());
     test.insertStagedBlob(testFile, blobID);
     // run test
@@ -138,7 +161,7 @@ static void testAdd02() {
     assert(test.getStagedBlobID(testFile).empty());
     assert(!fs::is_empty(Blob::getDir()));
     // tear down
-    assert(clearGitlet() == 7);  // 4 directories, 2 commits and 1 blob
+    assert(clearGitlet() == 4);  // 2 commits, 1 tree and 1 blob
     assert(fs::remove(testFile));
     cout << "test add 02 successfully" << endl;
 }
@@ -159,11 +182,78 @@ static void testAdd03() {
     ce.execCommand(test, args);
     assert(!test.isRemoved(testFile));
     // tear down
-    assert(clearGitlet() == 6);  // 4 directories, 1 commit, 1 blob
+    assert(clearGitlet() == 2);  // 1 commit, 1 blob
     assert(fs::remove(testFile));
     cout << "test add 03 successfully" << endl;
 }
 
+// test for add
+// file larger than a hashing chunk keeps the id of the whole content
+static void testAdd04() {
+    cout << "start to test add 04" << endl;
+    // set up
+    Gitlet test = setUp();
+    string testFile = "test.txt";
+    string content;
+    for (size_t i = 0; content.size() < 3 * utils::chunkSize + 7; ++i) {
+        content.append(std::to_string(i * i));
+    }
+    utils::writeFile(testFile, content);
+    // run test
+    assert(utils::hashFile(testFile) == utils::hash({content}));
+    vector<string> args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    string blobID = test.getStagedBlobID(testFile);
+    assert(blobID == Blob(content).getID());
+    Blob testBlob;
+    utils::loadObject(testBlob, Blob::getDir(), blobID);
+    assert(testBlob.getID() == blobID);
+    assert(testBlob.getContent() == content);
+    // adding it again keeps the saved blob
+    ce.execCommand(test, args);
+    assert(test.getStagedBlobID(testFile) == blobID);
+    assert(fs::exists(utils::objectPath(Blob::getDir(), blobID)));
+    // tear down
+    assert(clearGitlet() == 2);  // 1 commit, 1 blob
+    assert(fs::remove(testFile));
+    cout << "test add 04 successfully" << endl;
+}
+
+// test for add
+// several paths and a whole directory
+static void testAdd05() {
+    cout << "start to test add 05" << endl;
+    // set up
+    Gitlet test = setUp();
+    vector<string> testFiles = {"a.txt", "b.txt", "c.txt"};
+    for (const auto &file : testFiles) {
+        utils::writeFile(file, "content of " + file);
+    }
+    // run test
+    vector<string> args = {"./unittest", "add", "a.txt", "./b.txt"};
+    ce.execCommand(test, args);
+    assert(test.getStagedBlobID("a.txt") == utils::hash({"content of a.txt"}));
+    assert(test.getStagedBlobID("b.txt") == utils::hash({"content of b.txt"}));
+    assert(test.getStagedBlobID("c.txt").empty());
+    args = {"./unittest", "add", "."};
+    ce.execCommand(test, args);
+    for (const auto &file : testFiles) {
+        string blobID = test.getStagedBlobID(file);
+        assert(blobID == utils::hash({"content of " + file}));
+        assert(fs::exists(utils::objectPath(Blob::getDir(), blobID)));
+    }
+    assert(test.getStagedBlob().size() == testFiles.size());
+    args = {"./unittest", "add", "a.txt", "missing.txt"};
+    ASSERT_THROW(ce.execCommand(test, args), runtime_error,
+                 "File does not exist.");
+    // tear down
+    assert(clearGitlet() == 4);  // 1 commit, 3 blobs
+    for (const auto &file : testFiles) {
+        assert(fs::remove(file));
+    }
+    cout << "test add 05 successfully" << endl;
+}
+
 // test for commit
 // staged a file
 static void testCommit01() {
@@ -184,15 +274,16 @@ static void testCommit01() {
     ce.execCommand(test, args);
     string newHead = test.getHead();
     Commit cur;
-    fs::path cPath = Commit::getDir() / newHead;
+    fs::path cPath = utils::objectPath(Commit::getDir(), newHead);
     assert(fs::exists(cPath));
-    utils::load(cur, cPath);
+    Commit::read(newHead, cur);
     assert(cur.blobExists(blobID));
     assert(test.isStageEmpty());
     assert(cur.getParent1() == oldHead);
     assert(cur.getLog() == log);
     // tear down
-    assert(clearGitlet() == 7);  // 4 directories, 1 blob and 2 commits
+    // 1 blob, 2 commits, 1 tree, index, commit-graph and its count
+    assert(clearGitlet() == 7);
     assert(fs::remove(testFile));
     cout << "test commit 01 successfully" << endl;
 }
@@ -228,14 +319,15 @@ static void testCommit02() {
     ce.execCommand(test, args);
     string newHead = test.getHead();
     Commit cur;
-    fs::path cPath = Commit::getDir() / newHead;
+    fs::path cPath = utils::objectPath(Commit::getDir(), newHead);
     assert(fs::exists(cPath));
-    utils::load(cur, cPath);
+    Commit::read(newHead, cur);
     assert(cur.blobExists(blobID));
     assert(cur.blobExists(blobID2));
     assert(cur.getParent1() == oldHead);
     // tear down
-    assert(clearGitlet() == 9);  // 4 directories, 2 blobs and 3 commits
+    // 2 blobs, 3 commits, 2 trees, index, commit-graph and its count
+    assert(clearGitlet() == 10);
     assert(fs::remove(testFile));
     assert(fs::remove(testFile2));
     cout << "test commit 02 successfully" << endl;
@@ -269,13 +361,14 @@ static void testCommit03() {
     ce.execCommand(test, args);
     string newHead = test.getHead();
     Commit cur;
-    fs::path cPath = Commit::getDir() / newHead;
+    fs::path cPath = utils::objectPath(Commit::getDir(), newHead);
     assert(fs::exists(cPath));
-    utils::load(cur, cPath);
+    Commit::read(newHead, cur);
     assert(!cur.blobExists(blobID));
     assert(cur.blobExists(blobID2));
     // tear down
-    assert(clearGitlet() == 9);  // 4 directories, 2 blob and 3 commits
+    // 2 blob, 3 commits, 2 trees, index, commit-graph and its count
+    assert(clearGitlet() == 10);
     assert(fs::remove(testFile));
     cout << "test commit 03 successfully" << endl;
 }
@@ -300,12 +393,13 @@ static void testCommit04() {
     ce.execCommand(test, args);
     string newHead = test.getHead();
     Commit cur;
-    fs::path cPath = Commit::getDir() / newHead;
+    fs::path cPath = utils::objectPath(Commit::getDir(), newHead);
     assert(fs::exists(cPath));
-    utils::load(cur, cPath);
+    Commit::read(newHead, cur);
     assert(!cur.blobExists(blobID));
     // tear down
-    assert(clearGitlet() == 8);  // 4 directories, 1 blob and 3 commits
+    // 1 blob, 3 commits, 1 tree, index, commit-graph and its count
+    assert(clearGitlet() == 8);
     assert(fs::remove(testFile));
     cout << "test commit 04 successfully" << endl;
 }
@@ -328,7 +422,7 @@ static void testRm01() {
     assert(test.getStagedBlobID(testFile).empty());
     assert(fs::exists(testFile));
     // tear down
-    assert(clearGitlet() == 6);  // 4 directories, 1 commit, 1 blob
+    assert(clearGitlet() == 2);  // 1 commit, 1 blob
     assert(fs::remove(testFile));
     cout << "test rm 01 successfully" << endl;
 }
@@ -358,15 +452,53 @@ static void testRm02() {
     ce.execCommand(test, args);
     string head = test.getHead();
     Commit cur;
-    fs::path cPath = Commit::getDir() / head;
+    fs::path cPath = utils::objectPath(Commit::getDir(), head);
     assert(fs::exists(cPath));
-    utils::load(cur, cPath);
+    Commit::read(head, cur);
     assert(!cur.blobExists(blobID));
     // tear down
-    assert(clearGitlet() == 8);  // 4 directories, 1 blob, 3 commits
+    // 1 blob, 3 commits, 1 tree, index, commit-graph and its count
+    assert(clearGitlet() == 8);
     cout << "test rm 02 successfully" << endl;
 }
 
+// test for rm
+// paths are taken as the repository keeps them, "./test.txt" is "test.txt",
+// and paths outside the working files are refused
+static void testRm03() {
+    cout << "start to test rm 03" << endl;
+    // set up
+    Gitlet test = setUp();
+    string testFile = "test.txt";
+    utils::writeFile(testFile, "hello");
+    vector<string> args = {"./unittest", "add", "./" + testFile};
+    ce.execCommand(test, args);
+    assert(!test.getStagedBlobID(testFile).empty());
+    args = {"./unittest", "commit", "add testFile"};
+    ce.execCommand(test, args);
+    // run test
+    args = {"./unittest", "rm", "./" + testFile};
+    ce.execCommand(test, args);
+    assert(test.isRemoved(testFile));
+    args = {"./unittest", "commit", "remove testFile"};
+    ce.execCommand(test, args);
+    assert(Commit::load(test.getHead())->getBlobID(testFile).empty());
+    for (const char *path : {"..", "/tmp", ".gitlet", ".gitlet/info/"}) {
+        bool thrown = false;
+        try {
+            args = {"./unittest", "add", path};
+            ce.execCommand(test, args);
+        } catch (const runtime_error &e) {
+            thrown = string(e.what()).find("Path is") == 0;
+        }
+        assert(thrown);
+    }
+    // tear down
+    // 3 commits, 1 tree, 1 blob, index, commit-graph and its count
+    assert(clearGitlet() == 8);
+    cout << "test rm 03 successfully" << endl;
+}
+
 // test for checkout
 // take the version in (head) commit
 void testCheckout01() {
@@ -389,25 +521,173 @@ void testCheckout01() {
     args = {"./unittest", "checkout", "--", testFile};
     ce.execCommand(test, args);
     string finalContent = utils::readFile(testFile);
-    assert(utils::sha1({finalContent}) == blobID);
+    assert(utils::hash({finalContent}) == blobID);
     // with total commit id
     utils::writeFile(testFile, newContent);
     string head = test.getHead();
     args = {"./unittest", "checkout", head, "--", testFile};
     ce.execCommand(test, args);
     finalContent = utils::readFile(testFile);
-    assert(utils::sha1({finalContent}) == blobID);
+    assert(utils::hash({finalContent}) == blobID);
     // with shortened commit id
     args = {"./unittest", "checkout", head.substr(0, 10), "--", testFile};
     ce.execCommand(test, args);
     finalContent = utils::readFile(testFile);
-    assert(utils::sha1({finalContent}) == blobID);
+    assert(utils::hash({finalContent}) == blobID);
     // tear down
-    assert(clearGitlet() == 7);  // 4 directories, 1 blob, 2 commits
+    // 1 blob, 2 commits, 1 tree, index, commit-graph and its count
+    assert(clearGitlet() == 7);
     assert(fs::remove(testFile));
     cout << "test checkout 01 successfully" << endl;
 }
 
+// test for log
+// log uses the commits other commands cached, and reads the others in place
+// rather than filling the cache
+void testLog01() {
+    cout << "start to test log 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    string testFile = "test.txt";
+    utils::writeFile(testFile, "hello");
+    vector<string> args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "log testFile"};
+    ce.execCommand(test, args);
+    string head = test.getHead();
+    // run test
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    args = {"./unittest", "log"};
+    ce.execCommand(test, args);
+    cout.rdbuf(old);
+    assert(out.str().find("commit " + head) != string::npos);
+    assert(out.str().find("log testFile") != string::npos);
+    utils::CacheStats before = Commit::getCacheStats();
+    auto cur = Commit::load(head);
+    utils::CacheStats after = Commit::getCacheStats();
+    assert(after.misses == before.misses + 1);
+    assert(Commit::load(head) == cur);
+    assert(Commit::getCacheStats().hits == after.hits + 1);
+    // tear down
+    // 1 blob, 2 commits, 1 tree, index, commit-graph and its count
+    assert(clearGitlet() == 7);
+    assert(fs::remove(testFile));
+    cout << "test log 01 successfully" << endl;
+}
+
+// test for merge
+// files changed on one side are taken, changed on both sides conflict
+void testMerge01() {
+    cout << "start to test merge 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    // a: changed on other, b: removed on other, c: changed on both,
+    // d: added on other
+    for (string file : {"a.txt", "b.txt", "c.txt"}) {
+        utils::writeFile(file, file + " base\n");
+    }
+    vector<string> args = {"./unittest", "add", "."};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "base"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "branch", "other"};
+    ce.execCommand(test, args);
+    utils::writeFile("c.txt", "c.txt master\n");
+    args = {"./unittest", "add", "c.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "master change"};
+    ce.execCommand(test, args);
+    string masterHead = test.getHead();
+    args = {"./unittest", "checkout", "other"};
+    ce.execCommand(test, args);
+    utils::writeFile("a.txt", "a.txt other\n");
+    utils::writeFile("c.txt", "c.txt other\n");
+    utils::writeFile("d.txt", "d.txt other\n");
+    args = {"./unittest", "add", "a.txt", "c.txt", "d.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "rm", "b.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "other change"};
+    ce.execCommand(test, args);
+    string otherHead = test.getHead();
+    args = {"./unittest", "checkout", "master"};
+    ce.execCommand(test, args);
+    // run test
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    args = {"./unittest", "merge", "other"};
+    ce.execCommand(test, args);
+    cout.rdbuf(old);
+    assert(out.str() == "Encountered a merge conflict.\n");
+    assert(utils::readFile("a.txt") == "a.txt other\n");
+    assert(!fs::exists("b.txt"));
+    assert(utils::readFile("c.txt") ==
+           "<<<<<<< HEAD\nc.txt master\n=======\nc.txt other\n>>>>>>>\n");
+    assert(utils::readFile("d.txt") == "d.txt other\n");
+    auto merged = Commit::load(test.getHead());
+    assert(merged->getLog() == "Merged other into master.");
+    assert(merged->getParent1() == masterHead);
+    assert(merged->getParent2() == otherHead);
+    assert(merged->getBlobID("c.txt") == utils::hashFile("c.txt"));
+    assert(merged->getBlobID("b.txt").empty());
+    assert(test.getBranchCommitID("master") == test.getHead());
+    assert(test.isStageEmpty() && test.isRemovedEmpty());
+    // error cases
+    args = {"./unittest", "merge", "master"};
+    ASSERT_THROW(ce.execCommand(test, args), runtime_error,
+                 "Cannot merge a branch with itself.");
+    args = {"./unittest", "merge", "missing"};
+    ASSERT_THROW(ce.execCommand(test, args), runtime_error,
+                 "A branch with that name does not exist.");
+    // tear down
+    clearGitlet();
+    for (string file : {"a.txt", "c.txt", "d.txt"}) {
+        assert(fs::remove(file));
+    }
+    cout << "test merge 01 successfully" << endl;
+}
+
+// test for merge
+// fast-forward and merging an ancestor
+void testMerge02() {
+    cout << "start to test merge 02" << endl;
+    // set up
+    Gitlet test = setUp();
+    vector<string> args = {"./unittest", "branch", "other"};
+    ce.execCommand(test, args);
+    string testFile = "test.txt";
+    utils::writeFile(testFile, "hello");
+    args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "add testFile"};
+    ce.execCommand(test, args);
+    string head = test.getHead();
+    // run test
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    args = {"./unittest", "merge", "other"};
+    ce.execCommand(test, args);
+    assert(out.str() ==
+           "Given branch is an ancestor of the current branch.\n");
+    assert(test.getHead() == head);
+    args = {"./unittest", "checkout", "other"};
+    ce.execCommand(test, args);
+    assert(!fs::exists(testFile));
+    out.str("");
+    args = {"./unittest", "merge", "master"};
+    ce.execCommand(test, args);
+    cout.rdbuf(old);
+    assert(out.str() == "Current branch fast-forwarded.\n");
+    assert(test.getHead() == head);
+    assert(test.getBranchCommitID("other") == head);
+    assert(utils::readFile(testFile) == "hello");
+    // tear down
+    clearGitlet();
+    assert(fs::remove(testFile));
+    cout << "test merge 02 successfully" << endl;
+}
+
 // test for branch
 void testBranch01() {
     cout << "start to test branch 01" << endl;
@@ -422,23 +702,1368 @@ void testBranch01() {
     string id = test.getBranchCommitID(branchName);
     assert(id == head);
     // tear down
-    assert(clearGitlet() == 5);
+    assert(clearGitlet() == 1);
     cout << "test branch 01 successfully" << endl;
 }
 
+// test for repack
+// packed objects are still readable and loose ones are gone
+void testRepack01() {
+    cout << "start to test repack 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    string testFile = "test.txt";
+    string content = "hello";
+    utils::writeFile(testFile, content);
+    vector<string> args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    string blobID = test.getStagedBlobID(testFile);
+    args = {"./unittest", "commit", "add testFile"};
+    ce.execCommand(test, args);
+    string head = test.getHead();
+    // run test
+    args = {"./unittest", "repack"};
+    ce.execCommand(test, args);
+    assert(!fs::exists(utils::objectPath(Commit::getDir(), head)));
+    assert(!fs::exists(utils::objectPath(Blob::getDir(), blobID)));
+    assert(utils::objectExists(Commit::getDir(), head));
+    assert(utils::objectExists(Blob::getDir(), blobID));
+    assert(!utils::objectExists(Blob::getDir(), head));
+    assert(gitlet::pack::verify(Commit::getDir()));
+    assert(gitlet::pack::verify(Blob::getDir()));
+    Commit cur;
+    Commit::read(head, cur);
+    assert(cur.blobExists(blobID));
+    Blob blob;
+    utils::loadObject(blob, Blob::getDir(), blobID);
+    assert(blob.getContent() == content);
+    // shortened ids also resolve to packed commits
+    utils::writeFile(testFile, "world");
+    args = {"./unittest", "checkout", head.substr(0, 10), "--", testFile};
+    ce.execCommand(test, args);
+    assert(utils::readFile(testFile) == content);
+    // tear down
+    // 3 packs with their indexes, index, commit-graph and its count, bitmap
+    assert(clearGitlet() == 10);
+    assert(fs::remove(testFile));
+    cout << "test repack 01 successfully" << endl;
+}
+
+// test for index
+// cached ids are used until stat data changes, racy entries are rehashed
+void testIndex01() {
+    cout << "start to test index 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    string testFile = "test.txt";
+    string content = "hello";
+    utils::writeFile(testFile, content);
+    string blobID = utils::hash({content});
+    string fakeID = utils::hash({"fake"});
+    // run test
+    {
+        Index index;
+        assert(index.getBlobID(testFile) == blobID);
+        index.update(testFile, fakeID);
+        index.save();
+    }
+    // index file written after the file: the cached id is trusted
+    auto later = fs::last_write_time(testFile) + std::chrono::seconds(5);
+    fs::last_write_time(Index::getFile(), later);
+    {
+        Index index;
+        assert(index.getBlobID(testFile) == fakeID);
+    }
+    // index file as old as the file: racily clean, rehashed
+    fs::last_write_time(Index::getFile(), fs::last_write_time(testFile));
+    {
+        Index index;
+        assert(index.getBlobID(testFile) == blobID);
+    }
+    // a racy entry found unchanged is saved again, the index file then gets
+    // newer than the file, so it's no longer racy
+    auto earlier = fs::last_write_time(testFile) - std::chrono::seconds(5);
+    fs::last_write_time(testFile, earlier);
+    fs::last_write_time(Index::getFile(), earlier);
+    {
+        Index index;
+        index.update(testFile, blobID);
+        index.save();
+        fs::last_write_time(Index::getFile(), earlier);
+    }
+    {
+        Index index;
+        assert(index.getBlobID(testFile) == blobID);
+        index.save();
+    }
+    assert(fs::last_write_time(Index::getFile()) > earlier);
+    // stat data changed: rehashed
+    fs::last_write_time(Index::getFile(), later);
+    utils::writeFile(testFile, "world");
+    {
+        Index index;
+        assert(index.getBlobID(testFile) == utils::hash({"world"}));
+    }
+    // tear down
+    assert(clearGitlet() == 2);  // 1 commit, index
+    assert(fs::remove(testFile));
+    cout << "test index 01 successfully" << endl;
+}
+
+static ino_t inode(const fs::path &file) {
+    struct stat st;
+    assert(stat(file.c_str(), &st) == 0);
+    return st.st_ino;
+}
+
+// test for commit-graph
+// parents, generations and ancestry, also after the graph is rebuilt
+void testCommitGraph01() {
+    cout << "start to test commit-graph 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    string root = test.getHead();
+    vector<string> ids = {root};
+    for (int i = 0; i != 100; ++i) {
+        Commit c("commit " + std::to_string(i), "", ids.back());
+        c.save();
+        ids.push_back(c.getID());
+    }
+    Commit side("side", "", ids[10]);
+    side.save();
+    Commit merged("merged", "", ids.back(), side.getID());
+    merged.save();
+    // run test
+    // commits missing from the graph are added on lookup, and only written
+    // by save()
+    {
+        CommitGraph graph;
+        uint32_t pos = graph.lookup(merged.getID());
+        assert(CommitGraph().find(merged.getID()) == CommitGraph::none);
+        assert(graph.size() == ids.size() + 2);
+        assert(graph.getID(pos) == merged.getID());
+        assert(graph.getGeneration(pos) == ids.size() + 1);
+        assert(graph.getID(graph.getParent1(pos)) == ids.back());
+        assert(graph.getID(graph.getParent2(pos)) == side.getID());
+        assert(graph.getParent1(graph.find(root)) == CommitGraph::none);
+        assert(graph.getTime(graph.find(root)) == Commit(root).getTime());
+        graph.save();
+    }
+    // a long tail of added records is merged into the sorted ones when saved
+    CommitGraph graph;
+    assert(graph.size() == ids.size() + 2);
+    uint32_t pos = graph.find(merged.getID());
+    uint32_t sidePos = graph.find(side.getID());
+    assert(graph.getID(graph.getParent2(pos)) == side.getID());
+    assert(graph.isAncestor(graph.find(ids[5]), sidePos));
+    assert(!graph.isAncestor(graph.find(ids[11]), sidePos));
+    assert(graph.isAncestor(sidePos, pos));
+    assert(!graph.isAncestor(pos, sidePos));
+    for (size_t i = 1; i != ids.size(); ++i) {
+        assert(graph.getID(graph.getParent1(graph.find(ids[i]))) ==
+               ids[i - 1]);
+    }
+    assert(graph.mergeBase(graph.find(ids[50]), sidePos) ==
+           graph.find(ids[10]));
+    assert(graph.mergeBase(pos, sidePos) == sidePos);
+    assert(graph.mergeBase(graph.find(ids[3]), graph.find(ids[7])) ==
+           graph.find(ids[3]));
+    // shortened ids resolve in the sorted records and in the appended ones
+    Commit extra("extra", "", merged.getID());
+    extra.save();
+    // a commit is appended in place; one added in a transaction rolled back
+    // isn't counted, and the next append writes over it
+    fs::path graphFile = CommitGraph::getFile();
+    ino_t graphInode = inode(graphFile);
+    auto graphSize = fs::file_size(graphFile);
+    {
+        utils::Transaction tx;
+        CommitGraph added;
+        added.add(extra);
+        added.save();
+        assert(CommitGraph().find(extra.getID()) != CommitGraph::none);
+    }
+    assert(fs::file_size(graphFile) == graphSize + 40);
+    assert(CommitGraph().find(extra.getID()) == CommitGraph::none);
+    {
+        utils::Transaction tx;
+        CommitGraph added;
+        added.add(extra);
+        added.save();
+        tx.commit();
+    }
+    assert(inode(graphFile) == graphInode);
+    assert(fs::file_size(graphFile) == graphSize + 40);
+    assert(CommitGraph().find(extra.getID()) != CommitGraph::none);
+    test.insertBranchCommit("extra", extra.getID());
+    assert(test.resolveCommitID(extra.getID().substr(0, 8)) == extra.getID());
+    assert(test.resolveCommitID(ids[42].substr(0, 8)) == ids[42]);
+    string lower = ids[7].substr(0, 10);
+    for (char &c : lower) {
+        c = std::tolower(c);
+    }
+    assert(test.resolveCommitID(lower) == ids[7]);
+    ids.insert(ids.end(), {side.getID(), merged.getID(), extra.getID()});
+    sort(ids.begin(), ids.end());
+    CommitGraph reopened;
+    reopened.lookup(extra.getID());
+    for (char c : string("0123456789ABCDEF")) {
+        string prefix(1, c);
+        vector<string> expected;
+        for (const auto &id : ids) {
+            if (id[0] == c) {
+                expected.push_back(id);
+            }
+        }
+        assert(reopened.matchPrefix(prefix) == expected);
+        if (expected.size() > 1) {  // ambiguous prefixes are reported
+            string msg =
+                "The commit id " + prefix + " is ambiguous, it matches";
+            for (const auto &id : expected) {
+                msg += " " + id;
+            }
+            ASSERT_THROW(test.resolveCommitID(prefix), runtime_error, msg);
+        }
+    }
+    ASSERT_THROW(test.resolveCommitID("XYZ"), runtime_error,
+                 "No commit with that id exists.");
+    // tear down
+    assert(clearGitlet() == 106);  // 104 commits, commit-graph and its count
+    cout << "test commit-graph 01 successfully" << endl;
+}
+
+void testDelta01() {
+    cout << "start to test delta 01" << endl;
+    // deltas roundtrip, including edits at both ends and empty inputs
+    string base;
+    for (int i = 0; i != 500; ++i) {
+        base += "line " + std::to_string(i) + "\n";
+    }
+    for (const string &target :
+         {base, "head\n" + base.substr(7, 2000) + "tail\n", string(),
+          base.substr(0, 1000) + "inserted\n" + base.substr(1000)}) {
+        string d = gitlet::delta::create(base, target);
+        assert(gitlet::delta::apply(base, d) == target);
+    }
+    assert(gitlet::delta::apply("", gitlet::delta::create("", "abc")) ==
+           "abc");
+    string d = gitlet::delta::create(base, base + "x");
+    assert(d.size() < 32);
+    ASSERT_THROW(gitlet::delta::apply("short", d), runtime_error,
+                 "corrupt delta");
+    // edited files are stored as deltas against the committed version
+    Gitlet test = setUp();
+    string testFile = "test.txt";
+    vector<string> versions = {base};
+    utils::writeFile(testFile, base);
+    vector<string> args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "version 0"};
+    ce.execCommand(test, args);
+    string first = test.getHead();
+    for (unsigned i = 1; i <= Blob::maxDepth + 4; ++i) {
+        string content = versions.back() + "edit " + std::to_string(i) + "\n";
+        versions.push_back(content);
+        utils::writeFile(testFile, content);
+        args = {"./unittest", "add", testFile};
+        ce.execCommand(test, args);
+        string id = test.getStagedBlobID(testFile);
+        Blob blob;
+        utils::loadObject(blob, Blob::getDir(), id);
+        // a chain at its longest length starts over with a whole blob
+        if (i % (Blob::maxDepth + 1) == 0) {
+            assert(blob.getBase().empty() && blob.getContent() == content);
+        } else {
+            assert(!blob.getBase().empty());
+            assert(blob.getDepth() == i % (Blob::maxDepth + 1));
+            assert(blob.getContent().size() < content.size() / 2);
+        }
+        assert(Blob::loadContent(id) == content);
+        args = {"./unittest", "commit", "version " + std::to_string(i)};
+        ce.execCommand(test, args);
+    }
+    // checkout rebuilds the old version at the bottom of the chain
+    args = {"./unittest", "checkout", first, "--", testFile};
+    ce.execCommand(test, args);
+    assert(utils::readFile(testFile) == versions.front());
+    // and packed deltas still resolve
+    args = {"./unittest", "repack"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "checkout", test.getHead(), "--", testFile};
+    ce.execCommand(test, args);
+    assert(utils::readFile(testFile) == versions.back());
+    // tear down
+    // 3 packs with their indexes, index, commit-graph and its count, bitmap
+    assert(clearGitlet() == 10);
+    assert(fs::remove(testFile));
+    cout << "test delta 01 successfully" << endl;
+}
+
+// a blob staged again and replaced may still be the base of the delta of
+// the current commit's blob, it's kept
+void testDelta02() {
+    cout << "start to test delta 02" << endl;
+    // set up
+    Gitlet test = setUp();
+    string testFile = "test.txt";
+    string content(4096, 'x');
+    utils::writeFile(testFile, content + "1");
+    vector<string> args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "version 1"};
+    ce.execCommand(test, args);
+    utils::writeFile(testFile, content + "2");
+    args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "version 2"};
+    ce.execCommand(test, args);
+    // run test
+    utils::writeFile(testFile, content + "1");
+    args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    utils::writeFile(testFile, content + "3");
+    ce.execCommand(test, args);
+    args = {"./unittest", "checkout", "--", testFile};
+    ce.execCommand(test, args);
+    assert(utils::readFile(testFile) == content + "2");
+    // tear down
+    // 3 commits, 2 trees, 3 blobs, index, commit-graph and its count
+    assert(clearGitlet() == 11);
+    assert(fs::remove(testFile));
+    cout << "test delta 02 successfully" << endl;
+}
+
+void testCodec01() {
+    cout << "start to test codec 01" << endl;
+    namespace codec = gitlet::codec;
+    string text;
+    for (int i = 0; i != 5000; ++i) {
+        text += "row " + std::to_string(i % 97) + ", value\n";
+    }
+    string noise;
+    unsigned seed = 1;
+    for (int i = 0; i != 100000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        noise.push_back(char(seed >> 16));
+    }
+    // both codecs roundtrip, small or incompressible bytes stay raw
+    for (codec::Codec c : {codec::zlib, codec::lz}) {
+        codec::Settings s;
+        s.codec = c;
+        string encoded, decoded;
+        assert(codec::encode(text, encoded, s));
+        assert(codec::codecOf(encoded) == c);
+        assert(encoded.size() < text.size() / 4);
+        assert(codec::decode(encoded, decoded) && decoded == text);
+        assert(!codec::encode(noise, encoded, s));
+        assert(!codec::encode("short", encoded, s));
+        encoded.resize(encoded.size() - 3);
+        ASSERT_THROW(codec::decode(encoded, decoded), runtime_error,
+                     "corrupt object");
+    }
+    string decoded;
+    assert(!codec::decode(text, decoded));
+    // the codec is recorded per object, so a repository can mix them; the
+    // config is read once per command, not per object
+    Gitlet test = setUp();
+    utils::writeFile(utils::Config::getFile(),
+                     "# objects\ncompression = lz\n");
+    assert(codec::readSettings().codec == codec::lz);
+    assert(codec::settings().codec == codec::zlib);
+    codec::loadSettings();
+    assert(codec::settings().codec == codec::lz);
+    string file1 = "table1.txt", file2 = "table2.txt";
+    utils::writeFile(file1, text);
+    vector<string> args = {"./unittest", "add", file1};
+    ce.execCommand(test, args);
+    string id1 = test.getStagedBlobID(file1);
+    utils::writeFile(utils::Config::getFile(),
+                     "compression = zlib\ncompression.level = 9\n");
+    codec::loadSettings();
+    utils::writeFile(file2, text + noise);
+    args = {"./unittest", "add", file2};
+    ce.execCommand(test, args);
+    string id2 = test.getStagedBlobID(file2);
+    args = {"./unittest", "commit", "two codecs"};
+    ce.execCommand(test, args);
+    fs::path file = utils::objectPath(Blob::getDir(), id1);
+    assert(codec::codecOf(utils::readFile(file)) == codec::lz);
+    file = utils::objectPath(Blob::getDir(), id2);
+    assert(codec::codecOf(utils::readFile(file)) == codec::zlib);
+    assert(Blob::loadContent(id1) == text);
+    assert(Blob::loadContent(id2) == text + noise);
+    utils::writeFile(utils::Config::getFile(), "compression = zstd\n");
+    ASSERT_THROW(codec::loadSettings(), runtime_error,
+                 "unknown compression zstd");
+    utils::writeFile(utils::Config::getFile(), "compression = none\n");
+    codec::loadSettings();
+    assert(!codec::encode(text, decoded));
+    codec::setSettings(codec::Settings());
+    // tear down
+    // 2 commits, 2 blobs, 1 tree, index, commit-graph and its count, config
+    assert(clearGitlet() == 9);
+    assert(fs::remove(file1));
+    assert(fs::remove(file2));
+    cout << "test codec 01 successfully" << endl;
+}
+
+void testShard01() {
+    cout << "start to test shard 01" << endl;
+    // set up a repository with flat object directories
+    Gitlet test = setUp();
+    string head = test.getHead();
+    fs::path sharded = utils::objectPath(Commit::getDir(), head);
+    assert(sharded.parent_path().parent_path() == Commit::getDir());
+    fs::rename(sharded, Commit::getDir() / head);
+    fs::remove(sharded.parent_path());
+    vector<string> flat;
+    for (const char *content : {"old 1", "old 2"}) {
+        Blob blob(content);
+        utils::save(blob, Blob::getDir() / blob.getID());
+        flat.push_back(blob.getID());
+    }
+    // run test
+    // flat objects can be read
+    assert(utils::objectExists(Commit::getDir(), head));
+    assert(utils::objectExists(Blob::getDir(), flat[0]));
+    assert(Blob::loadContent(flat[1]) == "old 2");
+    // the first write moves them into shards
+    string testFile = "test.txt";
+    utils::writeFile(testFile, "new");
+    vector<string> args = {"./unittest", "add", testFile};
+    ce.execCommand(test, args);
+    for (const auto &id : flat) {
+        assert(!fs::exists(Blob::getDir() / id));
+        assert(fs::exists(utils::objectPath(Blob::getDir(), id)));
+    }
+    args = {"./unittest", "commit", "sharded"};
+    ce.execCommand(test, args);
+    assert(!fs::exists(Commit::getDir() / head));
+    assert(fs::exists(sharded));
+    assert(fs::exists(utils::objectPath(Commit::getDir(), test.getHead())));
+    assert(Commit::load(test.getHead())->getParent1() == head);
+    // tear down
+    // 2 commits, 3 blobs, 1 tree, index, commit-graph and its count
+    assert(clearGitlet() == 9);
+    assert(fs::remove(testFile));
+    cout << "test shard 01 successfully" << endl;
+}
+
+void testCheckout02() {
+    cout << "start to test checkout 02" << endl;
+    // set up
+    Gitlet test = setUp();
+    vector<string> files = {"a.txt", "b.txt", "c.txt"};
+    for (const auto &file : files) {
+        utils::writeFile(file, "content of " + file);
+    }
+    vector<string> args = {"./unittest", "add", "a.txt", "b.txt", "c.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "three files"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "branch", "other"};
+    ce.execCommand(test, args);
+    utils::writeFile("c.txt", "changed");
+    utils::writeFile("d.txt", "added");
+    args = {"./unittest", "add", "c.txt", "d.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "change c, add d"};
+    ce.execCommand(test, args);
+    utils::writeFile("a.txt", "modified");
+    auto mtime = fs::last_write_time("b.txt");
+    // run test
+    // only files that differ are written or removed
+    args = {"./unittest", "checkout", "other"};
+    ce.execCommand(test, args);
+    assert(fs::last_write_time("b.txt") == mtime);
+    for (const auto &file : files) {
+        assert(utils::readFile(file) == "content of " + file);
+    }
+    assert(!fs::exists("d.txt"));
+    args = {"./unittest", "checkout", "master"};
+    ce.execCommand(test, args);
+    assert(fs::last_write_time("b.txt") == mtime);
+    assert(utils::readFile("c.txt") == "changed");
+    assert(utils::readFile("d.txt") == "added");
+    // tear down
+    // 3 commits, 5 blobs, 2 trees, index, commit-graph and its count
+    assert(clearGitlet() == 13);
+    for (const auto &file : {"a.txt", "b.txt", "c.txt", "d.txt"}) {
+        assert(fs::remove(file));
+    }
+    cout << "test checkout 02 successfully" << endl;
+}
+
+void testJournal01() {
+    cout << "start to test journal 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    utils::writeFile("a.txt", "a");
+    string blobID = utils::hash({"a"});
+    vector<string> args = {"./unittest", "add", "a.txt"};
+    // run test
+    // saved objects are readable inside the transaction, but not in place
+    // until it commits, and are thrown away if it doesn't
+    {
+        utils::Transaction tx;
+        ASSERT_THROW(utils::Transaction(), runtime_error,
+                     "a transaction is already in progress");
+        ce.execCommand(test, args);
+        assert(Blob::loadContent(blobID) == "a");
+        assert(!fs::exists(utils::objectPath(Blob::getDir(), blobID)));
+        assert(fs::exists(utils::Transaction::getDir() /
+                          std::to_string(getpid())));
+    }
+    assert(!utils::objectExists(Blob::getDir(), blobID));
+    assert(fs::is_empty(utils::Transaction::getDir()));
+    {
+        utils::Transaction tx;
+        ce.execCommand(test, args);
+        tx.commit();
+    }
+    assert(Blob::loadContent(blobID) == "a");
+    assert(fs::is_empty(utils::Transaction::getDir()));
+    // a temp file replaced again is kept until the end, others may be
+    // reading it
+    {
+        utils::Transaction tx;
+        fs::path first = utils::tempFile(".gitlet");
+        utils::writeFile(first, "1");
+        utils::replaceFile(first, "b.txt");
+        fs::path second = utils::tempFile(".gitlet");
+        utils::writeFile(second, "2");
+        utils::replaceFile(second, "b.txt");
+        assert(fs::exists(first));
+        assert(utils::currentPath("b.txt") == second);
+        tx.commit();
+        assert(!fs::exists(first));
+    }
+    assert(utils::readFile("b.txt") == "2");
+    // a rollback undoes only what was replaced after the savepoint
+    {
+        utils::Transaction tx;
+        fs::path kept = utils::tempFile(".gitlet");
+        utils::writeFile(kept, "3");
+        utils::replaceFile(kept, "b.txt");
+        tx.savepoint();
+        fs::path again = utils::tempFile(".gitlet");
+        utils::writeFile(again, "4");
+        utils::replaceFile(again, "b.txt");
+        fs::path added = utils::tempFile(".gitlet");
+        utils::writeFile(added, "c");
+        utils::replaceFile(added, "c.txt");
+        utils::removeFile("a.txt");
+        tx.rollback();
+        assert(!fs::exists(again) && !fs::exists(added));
+        assert(utils::currentPath("b.txt") == kept);
+        assert(utils::currentPath("c.txt") == "c.txt");
+        tx.commit();
+    }
+    assert(utils::readFile("b.txt") == "3");
+    assert(!fs::exists("c.txt") && fs::exists("a.txt"));
+    // an exclusive lock waits for the transactions of other processes
+    int ready[2];
+    assert(pipe(ready) == 0);
+    pid_t holder = fork();
+    if (holder == 0) {
+        utils::Transaction tx;
+        assert(write(ready[1], "x", 1) == 1);
+        usleep(100000);
+        utils::writeFile("c.txt", "ended");
+        _exit(0);
+    }
+    char c;
+    assert(read(ready[0], &c, 1) == 1);
+    close(ready[0]);
+    close(ready[1]);
+    {
+        utils::Transaction tx;
+        tx.lockExclusive();
+        assert(fs::exists("c.txt"));
+    }
+    waitpid(holder, nullptr, 0);
+    assert(fs::remove("c.txt"));
+    // the next command deletes the temp files of a process that died
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    fs::path tmp = utils::tempFile(Blob::getDir());
+    utils::writeFile(tmp, "partial");
+    utils::writeFile(utils::Transaction::getDir() / std::to_string(pid),
+                     tmp.string() + "\n");
+    utils::Transaction::recover();
+    assert(!fs::exists(tmp));
+    assert(fs::is_empty(utils::Transaction::getDir()));
+    // tear down
+    assert(clearGitlet() == 2);  // 1 commit, 1 blob
+    assert(fs::remove("a.txt"));
+    assert(fs::remove("b.txt"));
+    cout << "test journal 01 successfully" << endl;
+}
+
+// a commit the way boost serialized it before the flat format
+class OldCommit : public GitletObj {
+  public:
+    string log = "old commit";
+    string timestamp = "Thu Jan  1 00:00:00 1970\n";
+    unordered_map<string, string> commitBlob = {{"b.txt", string(40, 'B')},
+                                                {"a.txt", string(40, 'A')}};
+    string parent1 = string(40, '1');
+    string parent2;
+
+  private:
+    friend class boost::serialization::access;
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+        ar &boost::serialization::base_object<GitletObj>(*this);
+        ar &log &timestamp &commitBlob;
+        ar &parent1 &parent2;
+    }
+};
+
+void testCommit05() {
+    cout << "start to test commit 05" << endl;
+    // set up
+    Gitlet test = setUp();
+    unordered_map<string, string> commitBlob;
+    for (int i = 0; i != 100; ++i) {
+        commitBlob["file" + std::to_string(i)] =
+            utils::hash({std::to_string(i)});
+    }
+    Commit c("flat", commitBlob, test.getHead());
+    c.save();
+    // run test
+    // the saved bytes are used in place, files sorted by name
+    Commit cur;
+    Commit::read(c.getID(), cur);
+    assert(cur.getLog() == "flat");
+    assert(cur.getTimeStamp() == c.getTimeStamp());
+    assert(cur.getParent1() == test.getHead());
+    assert(cur.getParent2().empty());
+    assert(cur.getFiles().size() == commitBlob.size());
+    string prev;
+    for (const auto &i : cur.getFiles()) {
+        assert(prev < i.first);
+        assert(commitBlob.at(string(i.first)) == i.second);
+        assert(cur.getBlobID(i.first) == i.second);
+        prev = i.first;
+    }
+    assert(cur.getBlobID("file").empty());
+    assert(cur.getBlobID("file99x").empty());
+    assert(cur.blobExists(commitBlob["file42"]));
+    assert(!cur.blobExists(string(40, '0')));
+    // commits saved by boost are still read
+    OldCommit old;
+    old.setID(string(40, 'C'));
+    utils::saveObject(old, Commit::getDir(), old.getID());
+    auto converted = Commit::load(old.getID());
+    assert(converted->getLog() == old.log);
+    assert(converted->getParent1() == old.parent1);
+    assert(converted->getBlobID("a.txt") == old.commitBlob["a.txt"]);
+    assert(converted->getBlobID("b.txt") == old.commitBlob["b.txt"]);
+    // the blob index follows a commit read into the same object
+    Commit::read(old.getID(), cur);
+    assert(!cur.blobExists(commitBlob["file42"]));
+    assert(cur.blobExists(old.commitBlob["a.txt"]));
+    // malformed bytes are rejected
+    string bad = "GCMT";
+    utils::putU32(bad, 1);
+    utils::putU32(bad, 1000);  // files are in the tree, not the commit
+    string badID(40, 'D');
+    utils::writeFile(utils::newObjectPath(Commit::getDir(), badID), bad);
+    ASSERT_THROW(Commit::read(badID, cur), runtime_error, "corrupt commit");
+    bad[4] = 3;  // version
+    utils::writeFile(utils::objectPath(Commit::getDir(), badID), bad);
+    ASSERT_THROW(Commit::read(badID, cur), runtime_error,
+                 "unsupported commit version");
+    // tear down
+    assert(clearGitlet() == 5);  // 4 commits, 1 tree
+    cout << "test commit 05 successfully" << endl;
+}
+
+void testServer01() {
+    cout << "start to test server 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    utils::save(test, Gitlet::getFile());
+    utils::writeFile("a.txt", "a");
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        try {
+            gitlet::server::serve();
+        } catch (...) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    // run test
+    // commands run in the daemon, which keeps the state between them
+    std::ostringstream out;
+    bool ok = false;
+    vector<string> args = {"./unittest", "add", "a.txt"};
+    for (int i = 0; !gitlet::server::request(args, out, ok); ++i) {
+        assert(i != 500);
+        usleep(10000);  // until the daemon listens
+    }
+    assert(ok);
+    args = {"./unittest", "status"};
+    assert(gitlet::server::request(args, out, ok) && ok);
+    assert(out.str().find("=== Staged Files\na.txt\n") != string::npos);
+    // a failed command reports its error and changes nothing
+    out.str("");
+    args = {"./unittest", "commit", ""};
+    assert(gitlet::server::request(args, out, ok) && !ok);
+    assert(out.str() == "Please enter a commit message");
+    args = {"./unittest", "commit", "served"};
+    assert(gitlet::server::request(args, out, ok) && ok);
+    // a command run without the daemon is seen by it
+    Gitlet git;
+    gitlet::server::load(git);
+    assert(git.isStageEmpty());
+    args = {"./unittest", "branch", "other"};
+    gitlet::server::execute(git, args);
+    out.str("");
+    args = {"./unittest", "status"};
+    assert(gitlet::server::request(args, out, ok) && ok);
+    assert(out.str().find("other") != string::npos);
+    // stop it
+    args = {"./unittest", "daemon", "stop"};
+    assert(gitlet::server::request(args, out, ok) && ok);
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(!fs::exists(gitlet::server::getSocket()));
+    assert(!gitlet::server::request(args, out, ok));
+    // tear down
+    // 2 commits, 1 blob, 1 tree, index, commit-graph and its count, state
+    assert(clearGitlet() == 8);
+    assert(fs::remove("a.txt"));
+    cout << "test server 01 successfully" << endl;
+}
+
+void testBatch01() {
+    cout << "start to test batch 01" << endl;
+    // set up
+    clearGitlet();
+    utils::writeFile("a.txt", "a");
+    utils::writeFile("b.txt", "b");
+    // run test
+    // one bad command doesn't stop the others, quotes group words
+    std::istringstream in("init\nadd a.txt\n# a comment\n\ncommit \"\"\n"
+                          "commit \"add \\\"a\\\"\"\nbranch other\n"
+                          "add \"b.txt\ncheckpoint\nadd b.txt\n");
+    std::ostringstream err, out;
+    auto old = cout.rdbuf(out.rdbuf());
+    size_t failed = gitlet::server::batch("./unittest", in, '\n', err);
+    cout.rdbuf(old);
+    assert(failed == 2);
+    assert(err.str() == "command 5: Please enter a commit message\n"
+                        "command 8: a quote isn't closed\n");
+    // the state is saved at the end
+    Gitlet git;
+    gitlet::server::load(git);
+    assert(Commit::load(git.getHead())->getLog() == "add \"a\"");
+    assert(!git.getBranchCommitID("other").empty());
+    assert(!git.getStagedBlobID("b.txt").empty());
+    // commands may also end with NUL, so they can hold newlines
+    in = std::istringstream(string("commit \"two\nlines\"\0status\0", 26));
+    old = cout.rdbuf(out.rdbuf());
+    failed = gitlet::server::batch("./unittest", in, '\0', err);
+    cout.rdbuf(old);
+    assert(failed == 0);
+    gitlet::server::load(git);
+    assert(Commit::load(git.getHead())->getLog() == "two\nlines");
+    // tear down
+    // 3 commits, 2 blobs, 2 trees, index, commit-graph and its count, state
+    assert(clearGitlet() == 11);
+    assert(fs::remove("a.txt"));
+    assert(fs::remove("b.txt"));
+    cout << "test batch 01 successfully" << endl;
+}
+
+void testBatch02() {
+    cout << "start to test batch 02" << endl;
+    // set up
+    clearGitlet();
+    std::istringstream in("init\n");
+    std::ostringstream err;
+    assert(gitlet::server::batch("./unittest", in, '\n', err) == 0);
+    Gitlet git;
+    gitlet::server::load(git);
+    string initID = git.getHead();
+    utils::writeFile("a.txt", "a");
+    // a corrupt commit-graph makes commit fail after it changed the state
+    utils::writeFile(CommitGraph::getFile(), "junk");
+    // run test
+    // the failed command is undone, the good ones around it are kept
+    in = std::istringstream("add a.txt\ncommit one\nbranch other\n");
+    size_t failed = gitlet::server::batch("./unittest", in, '\n', err);
+    assert(failed == 1);
+    assert(err.str() == "command 2: corrupt commit-graph file\n");
+    git = Gitlet();
+    gitlet::server::load(git);
+    assert(git.getHead() == initID);
+    assert(git.getBranchCommitID("master") == initID);
+    assert(git.getBranchCommitID("other") == initID);
+    assert(git.getStagedBlobID("a.txt") == utils::hash({"a"}));
+    assert(!fs::exists(Index::getFile()));
+    // tear down
+    // 1 commit, 1 blob, commit-graph, state
+    assert(clearGitlet() == 4);
+    assert(fs::remove("a.txt"));
+    cout << "test batch 02 successfully" << endl;
+}
+
+void testState01() {
+    cout << "start to test state 01" << endl;
+    // set up
+    clearGitlet();
+    Gitlet git;
+    gitlet::server::execute(git, {"./unittest", "init"});
+    assert(!git.isDirty());
+    utils::writeFile("a.txt", "a");
+    // run test
+    // setters only mark the state dirty when they change it
+    git.setHead(git.getHead());
+    git.eraseStagedBlob("a.txt");
+    git.clearRemovedBlob();
+    assert(!git.isDirty());
+    git.insertRemovedBlob("a.txt");
+    assert(git.isDirty());
+    git.markClean();
+    // read-only commands and commands changing nothing don't save the state,
+    // which would replace its file; status saves the index, so it isn't
+    // read-only
+    assert(ce.isReadOnly("log") && !ce.isReadOnly("status"));
+    gitlet::server::execute(git, {"./unittest", "add", "a.txt"});
+    ino_t saved = inode(Gitlet::getFile());
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    gitlet::server::execute(git, {"./unittest", "log"});
+    gitlet::server::execute(git, {"./unittest", "status"});
+    gitlet::server::execute(git, {"./unittest", "add", "a.txt"});
+    cout.rdbuf(old);
+    assert(inode(Gitlet::getFile()) == saved);
+    assert(!fs::exists(CommitGraph::getFile()));
+    gitlet::server::execute(git, {"./unittest", "branch", "other"});
+    assert(inode(Gitlet::getFile()) != saved);
+    // the state of an older repository, named by its id, is renamed
+    fs::path legacy = Gitlet::getDir() / git.getID();
+    fs::rename(Gitlet::getFile(), legacy);
+    Gitlet loaded;
+    gitlet::server::load(loaded);
+    assert(!fs::exists(legacy) && fs::exists(Gitlet::getFile()));
+    assert(!loaded.isDirty());
+    assert(loaded.getHead() == git.getHead());
+    assert(!loaded.getBranchCommitID("other").empty());
+    // tear down
+    // 1 commit, 1 blob, index, state
+    assert(clearGitlet() == 4);
+    assert(fs::remove("a.txt"));
+    cout << "test state 01 successfully" << endl;
+}
+
+#ifndef GITLET_NO_TRACE
+// value of the counter name in the last counters line of a trace
+static unsigned long traceCounter(const string &trace, const string &name) {
+    size_t pos = trace.rfind("\"" + name + "\":");
+    assert(pos != string::npos);
+    return std::stoul(trace.substr(pos + name.size() + 3));
+}
+#endif
+
+void testTrace01() {
+    cout << "start to test trace 01" << endl;
+    // set up
+    clearGitlet();
+    fs::path file = "/tmp/gitlet-trace.json";
+    utils::writeFile("a.txt", "a");
+    Gitlet git;
+    gitlet::server::execute(git, {"./unittest", "init"});
+    // run test
+    // nothing is recorded while tracing is off
+    gitlet::trace::count(gitlet::trace::fsyncs);
+    assert(gitlet::trace::counters[gitlet::trace::fsyncs] == 0);
+    fs::remove(file);
+#ifdef GITLET_NO_TRACE
+    // compiled out, starting records nothing
+    gitlet::trace::start(file, false);
+    gitlet::server::execute(git, {"./unittest", "add", "a.txt"});
+    gitlet::trace::stop();
+    assert(!gitlet::trace::enabled() && !fs::exists(file));
+    assert(gitlet::trace::counters[gitlet::trace::objectsWritten] == 0);
+#else
+    // every command is a scope, with the phases inside it
+    gitlet::trace::start(file, false);
+    gitlet::server::execute(git, {"./unittest", "add", "a.txt"});
+    gitlet::trace::stop();
+    string trace = utils::readFile(file);
+    assert(trace.find("{\"type\":\"scope\",\"name\":\"add\","
+                      "\"cat\":\"command\"") != string::npos);
+    assert(trace.find("\"name\":\"hash\"") != string::npos);
+    assert(trace.find("\"name\":\"save\"") != string::npos);
+    assert(trace.find("{\"type\":\"counters\"") != string::npos);
+    assert(traceCounter(trace, "objects_written") >= 2);  // blob, state
+    assert(traceCounter(trace, "bytes_hashed") >= 1);
+    assert(traceCounter(trace, "fsyncs") >= 1);
+    // the Chrome format is an array of complete events
+    gitlet::trace::start(file, true);
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    gitlet::server::execute(git, {"./unittest", "log"});
+    cout.rdbuf(old);
+    gitlet::trace::stop();
+    trace = utils::readFile(file);
+    assert(trace.compare(0, 2, "[\n") == 0);
+    assert(trace.find("{\"name\":\"log\",\"cat\":\"command\","
+                      "\"ph\":\"X\"") != string::npos);
+    assert(trace.find("\"ph\":\"C\"") != string::npos);
+    assert(traceCounter(trace, "objects_written") == 0);
+    assert(fs::remove(file));
+#endif
+    // tear down
+    // 1 commit, 1 blob, state
+    assert(clearGitlet() == 3);
+    assert(fs::remove("a.txt"));
+    cout << "test trace 01 successfully" << endl;
+}
+
+void testTree01() {
+    cout << "start to test tree 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    fs::create_directories("src/lib");
+    fs::create_directory("docs");
+    vector<string> files = {"docs/c.txt", "src-x.txt", "src/b.txt",
+                            "src/lib/a.txt", "top.txt"};
+    for (const auto &file : files) {
+        utils::writeFile(file, "content of " + file);
+    }
+    // run test
+    // a directory is added with everything below it
+    vector<string> args = {"./unittest", "add", "."};
+    ce.execCommand(test, args);
+    assert(test.getStagedBlob().size() == files.size());
+    args = {"./unittest", "commit", "nested"};
+    ce.execCommand(test, args);
+    auto first = Commit::load(test.getHead());
+    string root(first->getTree());
+    auto tree = Tree::load(root);
+    assert(tree->size() == 4);
+    assert(tree->getEntry(0).first == "docs/");
+    assert(tree->getEntry(1).first == "src-x.txt");
+    assert(tree->getEntry(2).first == "src/");
+    assert(tree->getEntry(3).first == "top.txt");
+    // the files of the trees come out in path order
+    vector<string> listed;
+    for (const auto &i : first->getFiles()) {
+        listed.emplace_back(i.first);
+    }
+    assert(listed == files);
+    assert(first->getBlobID("src/lib/a.txt") ==
+           Blob("content of src/lib/a.txt").getID());
+    // untouched directories are shared by the next commit
+    utils::writeFile("src/b.txt", "changed");
+    utils::writeFile("src/new.txt", "new");
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    args = {"./unittest", "status"};
+    ce.execCommand(test, args);
+    cout.rdbuf(old);
+    assert(out.str().find("=== Untracked Files ===\nsrc/new.txt\n") !=
+           string::npos);
+    assert(out.str().find("src/b.txt (modified)") != string::npos);
+    args = {"./unittest", "add", "src/b.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "change b"};
+    ce.execCommand(test, args);
+    fs::remove("src/new.txt");
+    string second(Commit::load(test.getHead())->getTree());
+    auto tree2 = Tree::load(second);
+    assert(tree2->find("docs/") == tree->find("docs/"));
+    assert(tree2->find("src/") != tree->find("src/"));
+    assert(Tree::load(string(tree2->find("src/")))->find("lib/") ==
+           Tree::load(string(tree->find("src/")))->find("lib/"));
+    vector<string> diffs;
+    Tree::diff(root, second,
+               [&](const string &file, std::string_view from,
+                   std::string_view to) {
+                   assert(!from.empty() && !to.empty());
+                   diffs.push_back(file);
+               });
+    assert(diffs == vector<string>{"src/b.txt"});
+    // a directory whose files are all removed leaves the tree
+    args = {"./unittest", "branch", "other"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "rm", "docs/c.txt"};
+    ce.execCommand(test, args);
+    assert(!fs::exists("docs"));
+    args = {"./unittest", "commit", "remove docs"};
+    ce.execCommand(test, args);
+    string third(Commit::load(test.getHead())->getTree());
+    assert(Tree::load(third)->find("docs/").empty());
+    // checkout makes and removes directories
+    args = {"./unittest", "checkout", "other"};
+    ce.execCommand(test, args);
+    assert(utils::readFile("docs/c.txt") == "content of docs/c.txt");
+    args = {"./unittest", "checkout", "master"};
+    ce.execCommand(test, args);
+    assert(!fs::exists("docs"));
+    assert(utils::readFile("src/b.txt") == "changed");
+    // malformed paths are rejected
+    ASSERT_THROW(Tree::update(third, {{"src//a.txt", "A"}}), runtime_error,
+                 "bad path src//a.txt");
+    // tear down
+    // 4 commits, 6 blobs, 7 trees, index, commit-graph and its count
+    assert(clearGitlet() == 20);
+    fs::remove_all("src");
+    assert(fs::remove("src-x.txt"));
+    assert(fs::remove("top.txt"));
+    cout << "test tree 01 successfully" << endl;
+}
+
+// output of a command
+static string runCaptured(Gitlet &git, const vector<string> &args) {
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    ce.execCommand(git, args);
+    cout.rdbuf(old);
+    return out.str();
+}
+
+// test for gc
+// unreachable loose objects older than the grace period are removed, the
+// reachable ones and the bases of their deltas are kept
+void testGc01() {
+    cout << "start to test gc 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    utils::writeFile("a.txt", "a");
+    vector<string> args = {"./unittest", "add", "a.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "add a"};
+    ce.execCommand(test, args);
+    string head = test.getHead();
+    string blobA(Commit::load(head)->getBlobID("a.txt"));
+    string treeA(Commit::load(head)->getTree());
+    // a staged blob stored as a delta against a blob nothing else refers to
+    string content(4096, 'x');
+    utils::writeFile("base.txt", content + "1");
+    string base = Blob::saveFile("base.txt");
+    utils::writeFile("c.txt", content + "2");
+    string staged = Blob::saveFile("c.txt");
+    Blob::deltify(staged, base);
+    Blob blob;
+    utils::loadObject(blob, Blob::getDir(), staged);
+    assert(blob.getBase() == base);
+    test.insertStagedBlob("c.txt", staged);
+    // a blob and the trees of a directory nothing refers to
+    utils::writeFile("b.txt", "b");
+    string dangling = Blob::saveFile("b.txt");
+    string danglingTree = Tree::update("", {{"d/b.txt", dangling}});
+    // run test
+    // everything was just written, so nothing is old enough yet
+    args = {"./unittest", "gc"};
+    assert(runCaptured(test, args) ==
+           "Removed 0 unreachable objects, reclaimed 0 bytes\n");
+    // with no time to sweep, each gc sweeps one shard and goes on from there
+    utils::writeFile(utils::Config::getFile(), "gc.sweepTime = 0\n");
+    args = {"./unittest", "gc", "--now"};
+    int runs = 0;
+    do {
+        string out = runCaptured(test, args);
+        assert(out.find("Removed ") == 0);
+        ++runs;
+    } while (fs::exists(Gc::getCursorFile()));
+    assert(runs > 1);
+    assert(!utils::objectExists(Blob::getDir(), dangling));
+    assert(!utils::objectExists(Tree::getDir(), danglingTree));
+    assert(utils::objectExists(Blob::getDir(), blobA));
+    assert(utils::objectExists(Blob::getDir(), staged));
+    assert(utils::objectExists(Blob::getDir(), base));
+    assert(utils::objectExists(Tree::getDir(), treeA));
+    assert(utils::objectExists(Commit::getDir(), head));
+    assert(Blob::loadContent(staged) == content + "2");
+    // tear down
+    // 2 commits, 3 blobs, 1 tree, index, commit-graph and its count, config
+    assert(clearGitlet() == 10);
+    for (const char *file : {"a.txt", "b.txt", "c.txt", "base.txt"}) {
+        assert(fs::remove(file));
+    }
+    cout << "test gc 01 successfully" << endl;
+}
+
+// ends of the chunks data is cut into
+static vector<size_t> cutPoints(std::string_view data) {
+    vector<size_t> ends;
+    size_t end = 0;
+    while (end != data.size()) {
+        end += gitlet::chunk::cut(data.substr(end));
+        ends.push_back(end);
+    }
+    return ends;
+}
+
+// test for chunking
+// large files are cut into chunks that edits leave unchanged around them,
+// which are shared between versions and restored from
+void testChunk01() {
+    cout << "start to test chunk 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    std::mt19937 gen(1);
+    string content(2 * Blob::chunkThreshold, '\0');
+    for (auto &c : content) {
+        c = char(gen());
+    }
+    // run test
+    // chunks are within bounds and an inserted byte only moves the cut
+    // points up to the next one after it
+    vector<size_t> ends = cutPoints(content);
+    assert(ends.size() > 2);
+    for (size_t i = 0; i != ends.size() - 1; ++i) {
+        size_t size = ends[i] - (i == 0 ? 0 : ends[i - 1]);
+        assert(size >= gitlet::chunk::minSize);
+        assert(size <= gitlet::chunk::maxSize);
+    }
+    string edited = content;
+    edited.insert(edited.begin() + 1000, 'x');
+    vector<size_t> editedEnds = cutPoints(edited);
+    assert(editedEnds.size() == ends.size());
+    for (size_t i = 1; i != ends.size(); ++i) {
+        assert(editedEnds[i] == ends[i] + 1);
+    }
+    // a large file is saved as its chunks, an edit adds one more
+    utils::writeFile("big.bin", content);
+    vector<string> args = {"./unittest", "add", "big.bin"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "add big"};
+    ce.execCommand(test, args);
+    string head = test.getHead();
+    string blobID(Commit::load(head)->getBlobID("big.bin"));
+    assert(blobID == utils::hashFile("big.bin"));
+    Blob blob;
+    utils::loadObject(blob, Blob::getDir(), blobID);
+    assert(blob.getChunks().size() == ends.size());
+    assert(blob.getContent().empty());
+    assert(Blob::loadContent(blobID) == content);
+    content[content.size() / 2] ^= 1;
+    utils::writeFile("big.bin", content);
+    args = {"./unittest", "add", "big.bin"};
+    ce.execCommand(test, args);
+    Blob changed;
+    utils::loadObject(changed, Blob::getDir(),
+                      test.getStagedBlobID("big.bin"));
+    size_t differ = 0;
+    for (size_t i = 0; i != ends.size(); ++i) {
+        differ += changed.getChunks()[i] != blob.getChunks()[i];
+    }
+    assert(differ == 1);
+    args = {"./unittest", "commit", "edit big"};
+    ce.execCommand(test, args);
+    // checkout writes the chunks back, gc keeps them
+    args = {"./unittest", "gc", "--now"};
+    std::ostringstream out;
+    auto old = cout.rdbuf(out.rdbuf());
+    ce.execCommand(test, args);
+    cout.rdbuf(old);
+    args = {"./unittest", "checkout", head, "--", "big.bin"};
+    ce.execCommand(test, args);
+    assert(utils::hashFile("big.bin") == blobID);
+    // tear down
+    // 3 commits, 2 chunked blobs with their chunks, 2 trees, index,
+    // commit-graph and its count
+    assert(clearGitlet() == 3 + 2 + ends.size() + 1 + 2 + 3);
+    assert(fs::remove("big.bin"));
+    cout << "test chunk 01 successfully" << endl;
+}
+
+// test for hash algorithms
+// a repository initialized with sha256 keeps making ids with it
+void testHash01() {
+    cout << "start to test hash 01" << endl;
+    // set up
+    clearGitlet();
+    string sha1ABC = "A9993E364706816ABA3E25717850C26C9CD0D89D";
+    string sha256ABC = "BA7816BF8F01CFEA414140DE5DAE2223B00361A3";
+    // run test
+    assert(utils::hash({"abc"}) == sha1ABC);
+    utils::setHashAlgorithm(utils::hashAlgorithm("sha256"));
+    assert(utils::hash({"a", "bc"}) == sha256ABC);
+    utils::setHashAlgorithm(utils::HashAlgorithm::sha1);
+    bool thrown = false;
+    try {
+        utils::hashAlgorithm("md5");
+    } catch (const runtime_error &e) {
+        thrown = true;
+    }
+    assert(thrown);
+    // the algorithm is recorded at init and loaded with the repository
+    Gitlet git;
+    gitlet::server::execute(git, {"./unittest", "init", "--hash", "sha256"});
+    utils::setHashAlgorithm(utils::HashAlgorithm::sha1);
+    Gitlet loaded;
+    gitlet::server::load(loaded);
+    assert(utils::hash({"abc"}) == sha256ABC);
+    utils::writeFile("a.txt", "abc");
+    utils::writeFile("b.txt", "b");
+    gitlet::server::execute(loaded, {"./unittest", "add", "a.txt", "b.txt"});
+    assert(loaded.getStagedBlobID("a.txt") == sha256ABC);
+    // ids of many files at once match those of one at a time
+    Index index;
+    vector<string> ids = index.getBlobIDs({"b.txt", "a.txt"});
+    assert(ids.size() == 2);
+    assert(ids[0] == utils::hashFile("b.txt") && ids[1] == sha256ABC);
+    utils::setHashAlgorithm(utils::HashAlgorithm::sha1);
+    // tear down
+    // 1 commit, 2 blobs, state, config
+    assert(clearGitlet() == 5);
+    assert(fs::remove("a.txt"));
+    assert(fs::remove("b.txt"));
+    cout << "test hash 01 successfully" << endl;
+}
+
+// test for reachability bitmaps
+// bitmaps round-trip through their compressed form, and the objects counted
+// with the bitmaps written by repack are those counted by walking history
+void testBitmap01() {
+    cout << "start to test bitmap 01" << endl;
+    // set up
+    Gitlet test = setUp();
+    vector<string> args;
+    for (int i = 0; i != 40; ++i) {
+        utils::writeFile("a.txt", "a" + std::to_string(i));
+        utils::writeFile("b.txt", "b" + std::to_string(i % 4));
+        args = {"./unittest", "add", "a.txt", "b.txt"};
+        ce.execCommand(test, args);
+        args = {"./unittest", "commit", "version " + std::to_string(i)};
+        ce.execCommand(test, args);
+    }
+    args = {"./unittest", "branch", "dev"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "checkout", "dev"};
+    ce.execCommand(test, args);
+    utils::writeFile("c.txt", "c");
+    args = {"./unittest", "add", "c.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "add c"};
+    ce.execCommand(test, args);
+    string dev = test.getHead();
+    args = {"./unittest", "checkout", "master"};
+    ce.execCommand(test, args);
+    // run test
+    gitlet::bitmap::Bitmap b;
+    for (size_t pos : {0, 5, 63, 1000}) {
+        b.set(pos);
+    }
+    for (size_t pos = 128; pos != 640; ++pos) {
+        b.set(pos);
+    }
+    string compressed;
+    b.compress(compressed);
+    assert(compressed.size() < 10 * 8);
+    gitlet::bitmap::Bitmap d = gitlet::bitmap::Bitmap::decompress(compressed);
+    assert(d.count() == 4 + 512);
+    assert(d.test(63) && d.test(128) && d.test(639) && d.test(1000));
+    assert(!d.test(64) && !d.test(640) && !d.test(999) && !d.test(5000));
+    bool thrown = false;
+    try {
+        gitlet::bitmap::Bitmap::decompress(compressed.substr(1));
+    } catch (const runtime_error &e) {
+        thrown = true;
+    }
+    assert(thrown);
+    // 42 commits, 41 trees, 40 blobs of a.txt, 4 of b.txt and 1 of c.txt
+    vector<vector<string>> counts = {{"./unittest", "count-objects"},
+                                     {"./unittest", "count-objects", "dev"},
+                                     {"./unittest", "count-objects", "dev",
+                                      "master"},
+                                     {"./unittest", "count-objects", "master",
+                                      "dev"}};
+    vector<string> walked;
+    for (const auto &count : counts) {
+        walked.push_back(runCaptured(test, count));
+    }
+    assert(walked[0] == "42 commits, 41 trees, 45 blobs\n");
+    assert(walked[2] == "1 commits, 1 trees, 1 blobs\n");
+    assert(walked[3] == "0 commits, 0 trees, 0 blobs\n");
+    args = {"./unittest", "repack"};
+    ce.execCommand(test, args);
+    assert(fs::exists(gitlet::bitmap::Bitmaps::getFile()));
+    for (size_t i = 0; i != counts.size(); ++i) {
+        assert(runCaptured(test, counts[i]) == walked[i]);
+    }
+    // commits made since the bitmaps are walked down to a commit with one
+    utils::writeFile("a.txt", "new");
+    args = {"./unittest", "add", "a.txt"};
+    ce.execCommand(test, args);
+    args = {"./unittest", "commit", "after repack"};
+    ce.execCommand(test, args);
+    string head = test.getHead();
+    assert(runCaptured(test, counts[0]) == "43 commits, 42 trees, 46 blobs\n");
+    assert(runCaptured(test, counts[3]) == "1 commits, 1 trees, 1 blobs\n");
+    gitlet::bitmap::Bitmaps bitmaps;
+    gitlet::bitmap::Reachable r = bitmaps.reachable({head});
+    assert(r.contains(gitlet::bitmap::commitKind, head));
+    assert(!r.contains(gitlet::bitmap::commitKind, dev));
+    assert(r.contains(gitlet::bitmap::blobKind, utils::hashFile("a.txt")));
+    // and gc keeps what they reach
+    args = {"./unittest", "gc", "--now"};
+    assert(runCaptured(test, args) ==
+           "Removed 0 unreachable objects, reclaimed 0 bytes\n");
+    assert(utils::objectExists(Commit::getDir(), head));
+    assert(Blob::loadContent(utils::hashFile("a.txt")) == "new");
+    // tear down
+    // 3 packs with their indexes, bitmap, 1 commit, 1 tree, 1 blob, index,
+    // commit-graph and its count
+    assert(clearGitlet() == 13);
+    assert(fs::remove("a.txt"));
+    assert(fs::remove("b.txt"));
+    cout << "test bitmap 01 successfully" << endl;
+}
+
 int main() {
     fs::current_path("/tmp/testGitlet");
     testInit();
     testAdd01();
     testAdd02();
     testAdd03();
+    testAdd04();
+    testAdd05();
     testCommit01();
     testCommit02();
     testCommit03();
     testCommit04();
     testRm01();
     testRm02();
+    testRm03();
     testCheckout01();
+    testLog01();
+    testMerge01();
+    testMerge02();
     testBranch01();
+    testRepack01();
+    testIndex01();
+    testCommitGraph01();
+    testDelta01();
+    testDelta02();
+    testCodec01();
+    testShard01();
+    testCheckout02();
+    testJournal01();
+    testCommit05();
+    testServer01();
+    testBatch01();
+    testBatch02();
+    testState01();
+    testTrace01();
+    testTree01();
+    testGc01();
+    testChunk01();
+    testHash01();
+    testBitmap01();
     return 0;
 }
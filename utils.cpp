@@ -1,35 +1,106 @@
 #include "utils.h"
 
-#include <cryptopp/files.h>
-#include <cryptopp/filters.h>
-#include <cryptopp/hex.h>
+#include "codec.h"
+#include "config.h"
+#include "journal.h"
+
+#include <cryptopp/cryptlib.h>
 #include <cryptopp/sha.h>
-#include <cryptopp/simple.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <exception>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 namespace fs = std::filesystem;
 namespace utils = gitlet::utils;
+namespace pack = gitlet::pack;
+namespace codec = gitlet::codec;
+namespace trace = gitlet::trace;
 using fs::file_size;
 using fs::path;
 using std::ifstream;
 using std::initializer_list;
 using std::ofstream;
 using std::runtime_error;
+using std::size_t;
 using std::string;
 
-string utils::sha1(initializer_list<string> il) {
-    using namespace CryptoPP;
-    string message, id, digest;
+static utils::HashAlgorithm algorithm = utils::HashAlgorithm::sha1;
+
+// bytes of an id, the digest is truncated to them
+static const size_t idSize = 20;
+
+utils::HashAlgorithm utils::hashAlgorithm(const string &name) {
+    if (name == "sha1") {
+        return HashAlgorithm::sha1;
+    } else if (name == "sha256") {
+        return HashAlgorithm::sha256;
+    }
+    throw runtime_error("unknown hash " + name);
+}
+
+void utils::setHashAlgorithm(HashAlgorithm a) { algorithm = a; }
+
+void utils::loadHashAlgorithm() {
+    setHashAlgorithm(hashAlgorithm(Config().get("hash", "sha1")));
+}
+
+string utils::hash(initializer_list<string> il) {
+    Hasher hash;
     for (const auto &str : il) {
-        message.append(str);
+        hash.update(str.data(), str.size());
+    }
+    return hash.final();
+}
+
+utils::Hasher::Hasher() {
+    if (algorithm == HashAlgorithm::sha256) {
+        hash.reset(new CryptoPP::SHA256);
+    } else {
+        hash.reset(new CryptoPP::SHA1);
+    }
+}
+
+utils::Hasher::~Hasher() = default;
+
+void utils::Hasher::update(const char *data, size_t size) {
+    trace::count(trace::bytesHashed, size);
+    hash->Update((const CryptoPP::byte *)data, size);
+}
+
+string utils::Hasher::final() {
+    unsigned char digest[idSize];
+    hash->TruncatedFinal(digest, idSize);
+    return toHex(std::string_view((const char *)digest, idSize));
+}
+
+string utils::hashFile(const path &file) {
+    trace::Scope scope("hash");
+    ifstream is(file, std::ios::binary);
+    if (!is.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    Hasher hash;
+    std::unique_ptr<char[]> buf(new char[chunkSize]);
+    while (is.read(buf.get(), chunkSize) || is.gcount() > 0) {
+        hash.update(buf.get(), is.gcount());
     }
-    SHA1 hash;
-    hash.Update((const byte *)message.data(), message.size());
-    digest.resize(hash.DigestSize());
-    hash.Final((byte *)&digest[0]);
-    HexEncoder encoder(new StringSink(id));
-    StringSource(digest, true, new Redirector(encoder));
-    return id;
+    return hash.final();
+}
+
+path utils::tempFile(const path &dir) {
+    static std::atomic<unsigned> counter{0};
+    return dir / ("tmp-" + std::to_string(getpid()) + "-" +
+                  std::to_string(counter++));
 }
 
 string utils::readFile(const path &file) {
@@ -51,3 +122,253 @@ void utils::writeFile(const path &file, string content) {
     }
     os << content;
 }
+
+void utils::parallelFor(size_t n, const std::function<void(size_t)> &f) {
+    size_t workers = std::min<size_t>(n, std::thread::hardware_concurrency());
+    if (workers <= 1) {
+        for (size_t i = 0; i != n; ++i) {
+            f(i);
+        }
+        return;
+    }
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto work = [&] {
+        for (size_t i; !failed && (i = next++) < n;) {
+            try {
+                f(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i != workers; ++i) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto &t : threads) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+utils::MappedFile::MappedFile(const path &file) {
+    if (!map(file.c_str())) {
+        throw runtime_error("cannot open the file");
+    }
+}
+
+bool utils::MappedFile::map(const char *file) {
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return false;
+        }
+        throw runtime_error("cannot open the file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw runtime_error("cannot open the file");
+    }
+    const unsigned char *newPtr = nullptr;
+    if (st.st_size != 0) {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("cannot map the file");
+        }
+        newPtr = static_cast<const unsigned char *>(p);
+    }
+    close(fd);
+    if (ptr) {
+        munmap(const_cast<unsigned char *>(ptr), len);
+    }
+    ptr = newPtr;
+    len = st.st_size;
+    return true;
+}
+
+utils::MappedFile::~MappedFile() {
+    if (ptr) {
+        munmap(const_cast<unsigned char *>(ptr), len);
+    }
+}
+
+utils::MappedFile::MappedFile(MappedFile &&other) noexcept
+    : ptr(other.ptr), len(other.len) {
+    other.ptr = nullptr;
+    other.len = 0;
+}
+
+utils::MappedFile &utils::MappedFile::operator=(MappedFile &&other) noexcept {
+    std::swap(ptr, other.ptr);
+    std::swap(len, other.len);
+    return *this;
+}
+
+void utils::saveBytes(std::string_view data, const path &file) {
+    string encoded;
+    if (codec::encode(data, encoded)) {
+        data = encoded;
+    }
+    path tmp = tempFile(file.parent_path());
+    ofstream os(tmp, std::ios::binary);
+    if (!os.is_open()) {
+        throw runtime_error("cannot open the file");
+    }
+    os.write(data.data(), data.size());
+    os.close();
+    if (!os) {
+        fs::remove(tmp);
+        throw runtime_error("cannot write the file");
+    }
+    replaceFile(tmp, file);
+    trace::count(trace::objectsWritten);
+}
+
+// map file, or the temp file replacing it in the current transaction, into
+// data unless it doesn't exist
+static bool mapFile(const path &file, utils::MappedFile &mapped,
+                    std::string_view &data) {
+    path cur = utils::currentPath(file);
+    std::error_code ec;
+    if (!fs::exists(cur, ec)) {
+        return false;
+    }
+    mapped = utils::MappedFile(cur);
+    data = std::string_view(reinterpret_cast<const char *>(mapped.data()),
+                            mapped.size());
+    return true;
+}
+
+std::string_view utils::loadBytes(const path &file, MappedFile &mapped,
+                                  string &decoded) {
+    std::string_view data;
+    if (!mapFile(file, mapped, data)) {
+        throw runtime_error("cannot open the file");
+    }
+    trace::count(trace::objectsRead);
+    return codec::decode(data, decoded) ? decoded : data;
+}
+
+std::string_view utils::loadObjectBytes(const path &dir, const string &id,
+                                        MappedFile &mapped, string &decoded) {
+    std::string_view data;
+    // the sharded path is tried again in case the flat directory was just
+    // sharded by another process
+    if (!mapFile(objectPath(dir, id), mapped, data) &&
+        !mapFile(dir / id, mapped, data) &&
+        !mapFile(objectPath(dir, id), mapped, data) &&
+        !pack::find(dir, id, data)) {
+        throw runtime_error("cannot open the file");
+    }
+    trace::count(trace::objectsRead);
+    return codec::decode(data, decoded) ? decoded : data;
+}
+
+path utils::objectPath(const path &dir, const string &id) {
+    if (id.size() < 3) {
+        throw runtime_error("bad object id " + id);
+    }
+    return dir / id.substr(0, 2) / id.substr(2);
+}
+
+path utils::newObjectPath(const path &dir, const string &id) {
+    static std::mutex shardMutex;
+    path file = objectPath(dir, id);
+    if (fs::is_directory(file.parent_path())) {
+        return file;
+    }
+    std::lock_guard<std::mutex> lock(shardMutex);
+    if (fs::create_directory(file.parent_path())) {
+        // move the objects of a flat directory into their shards
+        trace::Scope scope("scan");
+        std::vector<string> flat;
+        string raw;
+        for (auto &iter : fs::directory_iterator(dir)) {
+            string name = iter.path().filename();
+            if (iter.is_regular_file() && name.size() == 40 &&
+                fromHex(name, raw)) {
+                flat.push_back(name);
+            }
+        }
+        for (const auto &name : flat) {
+            path to = objectPath(dir, name);
+            fs::create_directory(to.parent_path());
+            fs::rename(dir / name, to);
+        }
+    }
+    return file;
+}
+
+bool utils::objectExists(const path &dir, const string &id) {
+    std::string_view data;
+    trace::count(trace::filesStated);
+    return fs::exists(currentPath(objectPath(dir, id))) ||
+           fs::exists(dir / id) || pack::find(dir, id, data);
+}
+
+string utils::toHex(std::string_view raw) {
+    string hex;
+    toHex(raw, hex);
+    return hex;
+}
+
+void utils::toHex(std::string_view raw, string &hex) {
+    static const char digits[] = "0123456789ABCDEF";
+    hex.resize(raw.size() * 2);
+    for (size_t i = 0; i != raw.size(); ++i) {
+        unsigned char c = raw[i];
+        hex[2 * i] = digits[c >> 4];
+        hex[2 * i + 1] = digits[c & 0xf];
+    }
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+bool utils::fromHex(const string &hex, string &raw) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    raw.clear();
+    raw.reserve(hex.size() / 2);
+    for (size_t i = 0; i != hex.size(); i += 2) {
+        int hi = hexValue(hex[i]), lo = hexValue(hex[i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        raw.push_back(char(hi << 4 | lo));
+    }
+    return true;
+}
+
+bool utils::getVarint(std::string_view s, size_t &pos, std::uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < s.size(); shift += 7) {
+        unsigned char c = s[pos++];
+        v |= std::uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -2,45 +2,207 @@
 #define UTILS_H
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <initializer_list>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
+#include <streambuf>
 #include <string>
+#include <string_view>
+
+#include "pack.h"
+#include "trace.h"
+
+namespace CryptoPP {
+class HashTransformation;
+}
 
 namespace gitlet {
 namespace utils {
+// size of the pieces large files are read and hashed in
+const std::size_t chunkSize = 1 << 16;
+
+// Loose objects of an object directory are sharded by the first two hex
+// digits of their id, "<dir>/<2 digits>/<other 38 digits>", so no directory
+// holds too many files. Repositories made before sharding keep them in
+// "<dir>/<id>" until their first write moves them into shards.
+//
+// path of the loose object with the given id
+std::filesystem::path objectPath(const std::filesystem::path &dir,
+                                 const std::string &id);
+// objectPath() of an object about to be written, its shard is created, and
+// the first time a shard is created, objects of a flat directory are moved
+// into shards
+std::filesystem::path newObjectPath(const std::filesystem::path &dir,
+                                    const std::string &id);
+// check whether an object can be loaded, loose or packed
+bool objectExists(const std::filesystem::path &dir, const std::string &id);
+
+// Object ids are made with the hash a repository was initialized with, named
+// by "hash" in its config: "sha1", the default, or "sha256", truncated to the
+// 20 bytes ids have in packs and the commit-graph. Both are Crypto++
+// transforms, which use the SHA instructions of the CPU if it has them. The
+// hash can't change once objects are saved, their ids would no longer match.
+enum class HashAlgorithm { sha1, sha256 };
+// algorithm of the given name, if unknown, throw a runtime_error
+HashAlgorithm hashAlgorithm(const std::string &name);
+// make ids with algorithm from now on
+void setHashAlgorithm(HashAlgorithm algorithm);
+// hashAlgorithm() named in the config of the current repository
+void loadHashAlgorithm();
+// compute hash for list of messages
+std::string hash(std::initializer_list<std::string> il);
+// incremental hash of the repository, the id of everything updated equals
+// hash() of its concatenation
+class Hasher {
+  public:
+    Hasher();
+    ~Hasher();
+    void update(const char *data, std::size_t size);
+    // return the hex id, the hash cannot be updated afterwards
+    std::string final();
+
+  private:
+    std::unique_ptr<CryptoPP::HashTransformation> hash;
+};
+// compute hash for the content of a file, reading it chunk by chunk, if cannot
+// open the file, throw a runtime_error
+std::string hashFile(const std::filesystem::path &file);
+// a path in dir that no other process or thread uses as temporary file
+std::filesystem::path tempFile(const std::filesystem::path &dir);
+// run f(0), ..., f(n - 1) on worker threads, one per core, if f throws, stop
+// handing out work and rethrow the first exception once all workers finished
+void parallelFor(std::size_t n, const std::function<void(std::size_t)> &f);
+// read an entire file into a std::string, if cannot open
+// the file, throw a runtime_error
+std::string readFile(const std::filesystem::path &file);
+// write the content into a file, if cannot open
+// the file, throw a runtime_error
+void writeFile(const std::filesystem::path &file, std::string content);
+// read-only memory mapping of a whole file
+class MappedFile {
+  public:
+    MappedFile() = default;
+    // map the file, if cannot open or map it, throw a runtime_error
+    explicit MappedFile(const std::filesystem::path &file);
+    ~MappedFile();
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    // map file in place of the current mapping, return false if it doesn't
+    // exist; if cannot open or map it otherwise, throw a runtime_error
+    bool map(const char *file);
+    const unsigned char *data() const { return ptr; }
+    std::size_t size() const { return len; }
+
+  private:
+    const unsigned char *ptr = nullptr;
+    std::size_t len = 0;
+};
+// write the serialized bytes of an object into file, compressed with the
+// codec of the config file unless they're small or incompressible; they're
+// written to a temp file that replaces file when the current transaction
+// commits, see journal.h; if cannot open the file, throw a runtime_error
+void saveBytes(std::string_view data, const std::filesystem::path &file);
 // serialize object into file, if cannot open
 // the file, throw a runtime_error
 template <typename T>
 void save(const T &obj, const std::filesystem::path &file) {
-    std::ofstream ofs(file, std::ios::binary);
-    if (!ofs.is_open()) {
-        throw std::runtime_error("cannot open the file");
+    trace::Scope scope("save");
+    std::ostringstream os;
+    {
+        boost::archive::binary_oarchive oa(os);
+        oa << obj;
     }
-    boost::archive::binary_oarchive oa(ofs);
-    oa << obj;
+    saveBytes(os.str(), file);
 }
 
-// deserialize object from file, if cannot open
-// the file, throw a runtime_error
+// read-only stream buffer over bytes owned by someone else
+class MemoryBuf : public std::streambuf {
+  public:
+    explicit MemoryBuf(std::string_view data) {
+        char *p = const_cast<char *>(data.data());
+        setg(p, p, p + data.size());
+    }
+};
+
+// serialized bytes saved into file, they're mapped into mapped, or decoded
+// into decoded if they were compressed; if cannot open the file, throw a
+// runtime_error
+std::string_view loadBytes(const std::filesystem::path &file,
+                           MappedFile &mapped, std::string &decoded);
+// the same for an object of dir, loose or packed; if cannot find the object,
+// throw a runtime_error
+std::string_view loadObjectBytes(const std::filesystem::path &dir,
+                                 const std::string &id, MappedFile &mapped,
+                                 std::string &decoded);
+// deserialize object from file, if cannot open the file, throw a
+// runtime_error
 template <typename T>
 void load(T &obj, const std::filesystem::path &file) {
-    std::ifstream ifs(file, std::ios::binary);
-    if (!ifs.is_open()) {
-        throw std::runtime_error("cannot open the file");
-    }
-    boost::archive::binary_iarchive ia(ifs);
+    trace::Scope scope("load");
+    MappedFile mapped;
+    std::string decoded;
+    MemoryBuf buf(loadBytes(file, mapped, decoded));
+    boost::archive::binary_iarchive ia(buf);
     ia >> obj;
 }
-// compute hash for list of messages
-std::string sha1(std::initializer_list<std::string> il);
-// read an entire file into a std::string, if cannot open
-// the file, throw a runtime_error
-std::string readFile(const std::filesystem::path &file);
-// write the content into a file, if cannot open
-// the file, throw a runtime_error
-void writeFile(const std::filesystem::path &file, std::string content);
+// serialize object as the object id of dir
+template <typename T>
+void saveObject(const T &obj, const std::filesystem::path &dir,
+                const std::string &id) {
+    save(obj, newObjectPath(dir, id));
+}
+// deserialize the object id of dir, loose or packed, if cannot find the
+// object, throw a runtime_error
+template <typename T>
+void loadObject(T &obj, const std::filesystem::path &dir,
+                const std::string &id) {
+    trace::Scope scope("load");
+    MappedFile mapped;
+    std::string decoded;
+    MemoryBuf buf(loadObjectBytes(dir, id, mapped, decoded));
+    boost::archive::binary_iarchive ia(buf);
+    ia >> obj;
+}
+// little-endian integers of the binary file formats
+inline std::uint32_t getU32(const unsigned char *p) {
+    return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 |
+           std::uint32_t(p[2]) << 16 | std::uint32_t(p[3]) << 24;
+}
+inline std::uint64_t getU64(const unsigned char *p) {
+    return std::uint64_t(getU32(p)) | std::uint64_t(getU32(p + 4)) << 32;
+}
+inline void putU32(std::string &s, std::uint32_t v) {
+    for (int i = 0; i != 4; ++i) {
+        s.push_back(char(v >> (8 * i)));
+    }
+}
+inline void putU64(std::string &s, std::uint64_t v) {
+    putU32(s, std::uint32_t(v));
+    putU32(s, std::uint32_t(v >> 32));
+}
+// variable-length integers, 7 bits per byte, low bits first
+inline void putVarint(std::string &s, std::uint64_t v) {
+    while (v >= 0x80) {
+        s.push_back(char(v & 0x7f) | char(0x80));
+        v >>= 7;
+    }
+    s.push_back(char(v));
+}
+// decode the varint at pos of s and advance pos past it, return false if
+// it's truncated or too long
+bool getVarint(std::string_view s, std::size_t &pos, std::uint64_t &v);
+// encode raw bytes as upper case hex, the format of object ids
+std::string toHex(std::string_view raw);
+// the same into hex, reusing its memory
+void toHex(std::string_view raw, std::string &hex);
+// decode hex into raw bytes, return false if hex is malformed
+bool fromHex(const std::string &hex, std::string &raw);
 }  // namespace utils
 }  // namespace gitlet
 